@@ -6,7 +6,13 @@
 #include <iostream>
 #include <algorithm>
 #include <random>
+#include <stdexcept>
 #include <string>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace cards_common
 {
@@ -56,7 +62,7 @@ size_t get_deck_size(CardDeckType deck_type) {
     case CardDeckType::CardDeck52:
         return 52;
     }
-    throw std::exception("Unknown card deck type");
+    throw std::runtime_error("Unknown card deck type");
 }
 
 struct Card
@@ -146,6 +152,13 @@ public:
     void shuffle_wo_last(unsigned int seed) {
         std::shuffle(storage_.begin(), storage_.end() - 1, std::default_random_engine(seed));
     }
+    //reverse order of all cards except card with index keep_idx
+    void reverse_wo(size_t keep_idx) {
+        const Card keep = storage_[keep_idx];
+        storage_.erase(storage_.begin() + keep_idx);
+        std::reverse(storage_.begin(), storage_.end());
+        storage_.insert(storage_.begin() + keep_idx, keep);
+    }
 
     friend std::ostream &operator << (std::ostream &os, const CardDeck &card);
 
@@ -196,6 +209,88 @@ private:
     std::deque<Card> storage_;
 };
 
+//bit mask of cards, bit of card is card_index(card)
+using CardMask = uint64_t;
+
+inline size_t card_index(const Card& card)
+{
+    return ((size_t)card.suit_ - (size_t)CardsSuit::Spades) * 13
+        + ((size_t)card.value_ - (size_t)CardsValue::Deuce);
+}
+inline Card card_from_index(size_t idx)
+{
+    return Card(
+        (CardsSuit)((size_t)CardsSuit::Spades + idx / 13),
+        (CardsValue)((size_t)CardsValue::Deuce + idx % 13));
+}
+inline CardMask card_mask(const Card& card)
+{
+    return CardMask(1) << card_index(card);
+}
+template <class _Cards>
+CardMask cards_mask(const _Cards& cards)
+{
+    CardMask mask = 0;
+    for (const Card& card : cards)
+        mask |= card_mask(card);
+    return mask;
+}
+inline CardMask suit_mask(CardsSuit suit)
+{
+    return CardMask(0x1FFF) << (((size_t)suit - (size_t)CardsSuit::Spades) * 13);
+}
+inline CardMask deck_mask(CardDeckType type)
+{
+    CardMask values = 0;
+    switch (type)
+    {
+    case CardDeckType::CardDeck32:
+        values = 0x1FFF & ~CardMask(0x1F); //without 2..6
+        break;
+    case CardDeckType::CardDeck36:
+        values = 0x1FFF & ~CardMask(0xF); //without 2..5
+        break;
+    case CardDeckType::CardDeck52:
+        values = 0x1FFF;
+        break;
+    default:
+        throw std::runtime_error("Invalid card deck type");
+    }
+    return values | (values << 13) | (values << 26) | (values << 39);
+}
+inline size_t mask_cards_count(CardMask mask)
+{
+#if defined(_MSC_VER)
+    return (size_t)__popcnt64(mask);
+#else
+    return (size_t)__builtin_popcountll(mask);
+#endif
+}
+//mask must be not empty
+inline size_t mask_first_card_index(CardMask mask)
+{
+#if defined(_MSC_VER)
+    unsigned long idx = 0;
+    _BitScanForward64(&idx, mask);
+    return (size_t)idx;
+#else
+    return (size_t)__builtin_ctzll(mask);
+#endif
+}
+//n-th card (in Card::operator< order) of mask, n must be less than mask_cards_count(mask)
+inline Card mask_nth_card(CardMask mask, size_t n)
+{
+    for (; n > 0; n--)
+        mask &= mask - 1;
+    return card_from_index(mask_first_card_index(mask));
+}
+//all cards with the same values as cards of mask
+inline CardMask same_values_mask(CardMask mask)
+{
+    const CardMask values = (mask | (mask >> 13) | (mask >> 26) | (mask >> 39)) & 0x1FFF;
+    return values | (values << 13) | (values << 26) | (values << 39);
+}
+
 using PairCard = std::pair<cards_common::Card, cards_common::Card>;
 using CardList = std::list< cards_common::Card >;
 
@@ -1,16 +1,179 @@
 #pragma once
 
 #include "cards_common.hpp"
+#include "durak_game_trace.hpp"
 
 #include "opencv2/core.hpp"
 #include "opencv2/highgui.hpp"
 #include "opencv2/imgproc.hpp"
 
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <tuple>
+#include <vector>
 
 namespace cards_renderer
 {
+enum RotateCode
+{
+    rcNone,
+    rc90cw,
+    rc180,
+    rc90ccw
+};
+
+/*
+        :     
+       ,       .
+*/
+class CardAtlas
+{
+public:
+    CardAtlas(const std::string &background_img_path,
+                const std::string &cards_deck_img_path,
+                const std::string &cards_back_img_path)
+    {
+        if (!background_img_path.empty())
+            background_image_ = cv::imread(background_img_path, cv::IMREAD_COLOR);
+        cards_back_image_ = cv::imread(cards_back_img_path, cv::IMREAD_COLOR);
+        cards_deck_image_ = cv::imread(cards_deck_img_path, cv::IMREAD_COLOR);
+        if (cards_deck_image_.empty())
+            return;
+
+        const cv::Size card_sz = get_card_img_size();
+        for (size_t idx = 0; idx < 52; idx++)
+        {
+            const cards_common::Card card = cards_common::card_from_index(idx);
+            const cv::Point tl(
+                ((int)card.value_ - (int)cards_common::CardsValue::ValueNone - 1) * card_sz.width,
+                ((int)card.suit_ - (int)cards_common::CardsSuit::SuitNone - 1) * card_sz.height);
+            card_images_.push_back(cards_deck_image_(cv::Rect(tl, card_sz)));
+        }
+    }
+
+    const cv::Mat &get_background_image() const
+    {
+        return background_image_;
+    }
+    cv::Mat get_card_image(const cards_common::Card &card) const
+    {
+        if (card_images_.empty())
+            return cv::Mat();
+        return card_images_[cards_common::card_index(card)];
+    }
+    cv::Size get_card_img_size() const
+    {
+        return cv::Size(cards_deck_image_.cols / 13, cards_deck_image_.rows / 4);
+    }
+    const cv::Mat &get_cards_back_image() const
+    {
+        return cards_back_image_;
+    }
+private:
+    /*
+            ,   WC x HC. 
+            : (13 * WC) x (4 * HC)
+    */
+    cv::Mat cards_deck_image_;
+    std::vector<cv::Mat> card_images_; //  cards_deck_image_  card_index
+    cv::Mat cards_back_image_;
+    cv::Mat background_image_;
+};
+
+/*
+      ,         .
+        ;    
+        .   
+       ,       .
+*/
+class SpriteStore
+{
+public:
+    explicit SpriteStore(std::shared_ptr<const CardAtlas> atlas)
+        : atlas_(std::move(atlas))
+    {
+    }
+
+    const CardAtlas &get_atlas() const
+    {
+        return *atlas_;
+    }
+    /*
+          (   ),   rotate 
+          size.    ,
+           -  .
+    */
+    const cv::Mat &get_card_sprite(const cards_common::Card &card, RotateCode rotate, const cv::Size &size) const
+    {
+        const bool is_back = (cards_common::CardsSuit::SuitNone == card.suit_ || cards_common::CardsValue::ValueNone == card.value_);
+        const SpriteKey key(is_back ? back_sprite_idx : (int)cards_common::card_index(card), rotate, size.width, size.height);
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = sprites_.find(key);
+            if (sprites_.end() != it)
+                return it->second;
+        }
+
+        const cv::Mat card_img = is_back ? atlas_->get_cards_back_image() : atlas_->get_card_image(card);
+        cv::Mat rotated;
+        switch (rotate)
+        {
+        case rcNone:
+            rotated = card_img;
+            break;
+        case rc90cw:
+            cv::rotate(card_img, rotated, cv::ROTATE_90_CLOCKWISE);
+            break;
+        case rc180:
+            cv::rotate(card_img, rotated, cv::ROTATE_180);
+            break;
+        case rc90ccw:
+            cv::rotate(card_img, rotated, cv::ROTATE_90_COUNTERCLOCKWISE);
+            break;
+        }
+        cv::Mat sprite;
+        if (!rotated.empty() && size != rotated.size())
+            cv::resize(rotated, sprite, size);
+        else
+            sprite = rotated.clone(); //       
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        return sprites_.emplace(key, sprite).first->second; //      -  
+    }
+
+    //     ,      
+    static std::shared_ptr<SpriteStore> shared(const std::string &background_img_path,
+                                               const std::string &cards_deck_img_path,
+                                               const std::string &cards_back_img_path)
+    {
+        static std::mutex stores_mutex;
+        static std::map<std::tuple<std::string, std::string, std::string>, std::shared_ptr<SpriteStore>> stores;
+
+        std::lock_guard<std::mutex> lock(stores_mutex);
+        std::shared_ptr<SpriteStore> &store = stores[std::make_tuple(background_img_path, cards_deck_img_path, cards_back_img_path)];
+        if (!store)
+            store = std::make_shared<SpriteStore>(
+                std::make_shared<const CardAtlas>(background_img_path, cards_deck_img_path, cards_back_img_path));
+        return store;
+    }
+private:
+    //   (back_sprite_idx - ), , , 
+    using SpriteKey = std::tuple<int, int, int, int>;
+    static constexpr int back_sprite_idx = 52;
+
+    std::shared_ptr<const CardAtlas> atlas_;
+    mutable std::shared_mutex mutex_;
+    mutable std::map<SpriteKey, cv::Mat> sprites_;
+};
+
+/*
+     :     SpriteStore, 
+       .     .
+*/
 class Resource
 {
 public:
@@ -26,58 +189,37 @@ public:
 
     const cv::Mat &get_background_image()
     {
-        if (background_img_path_.empty())
-            return background_image_;
-        if (background_image_.empty())
-            background_image_ = cv::imread(cards_back_img_path_, cv::IMREAD_COLOR);
-        return background_image_;
+        return get_store().get_atlas().get_background_image();
     }
     cv::Mat get_card_image(const cards_common::Card &card)
     {
-        if (cards_deck_image_.empty())
-            cards_deck_image_ = cv::imread(cards_deck_img_path_, cv::IMREAD_COLOR);
-
-        const cv::Size card_sz(cards_deck_image_.cols / 13, cards_deck_image_.rows / 4);
-
-        const cv::Point tl(
-            ((int)card.value_ - (int)cards_common::CardsValue::ValueNone - 1) * card_sz.width,
-            ((int)card.suit_ - (int)cards_common::CardsSuit::SuitNone - 1) * card_sz.height);
-
-        return cards_deck_image_(cv::Rect(tl, card_sz));
+        return get_store().get_atlas().get_card_image(card);
     }
     cv::Size get_card_img_size()
     {
-        if (cards_deck_image_.empty())
-            cards_deck_image_ = cv::imread(cards_deck_img_path_, cv::IMREAD_COLOR);
-
-        return cv::Size(cards_deck_image_.cols / 13, cards_deck_image_.rows / 4);
+        return get_store().get_atlas().get_card_img_size();
+    }
+    const cv::Mat &get_card_sprite(const cards_common::Card &card, RotateCode rotate, const cv::Size &size)
+    {
+        return get_store().get_card_sprite(card, rotate, size);
     }
     const cv::Mat &get_cards_back_image()
     {
-        if (cards_back_image_.empty())
-            cards_back_image_ = cv::imread(cards_back_img_path_, cv::IMREAD_COLOR);
-        return cards_back_image_;
+        return get_store().get_atlas().get_cards_back_image();
+    }
+private:
+    const SpriteStore &get_store()
+    {
+        if (!store_)
+            store_ = SpriteStore::shared(background_img_path_, cards_deck_img_path_, cards_back_img_path_);
+        return *store_;
     }
 private:
     std::string background_img_path_;
     std::string cards_deck_img_path_;
     std::string cards_back_img_path_;
 
-    /*
-            ,   WC x HC. 
-            : (13 * WC) x (4 * HC)
-    */
-    cv::Mat cards_deck_image_;
-    cv::Mat cards_back_image_;
-    cv::Mat background_image_;
-};
-
-enum RotateCode
-{
-    rcNone,
-    rc90cw,
-    rc180,
-    rc90ccw
+    std::shared_ptr<const SpriteStore> store_;
 };
 
 class TableRenderer
@@ -87,6 +229,11 @@ class TableRenderer
         cv::Rect rect_ = {};
         RotateCode rotate_ = rcNone;
         cards_common::Card card_ = {};
+
+        friend bool operator==(const RenderCard& l, const RenderCard& r)
+        {
+            return l.rect_ == r.rect_ && l.rotate_ == r.rotate_ && l.card_ == r.card_;
+        }
     };
 public:
     TableRenderer(const std::string &background_img_path,
@@ -134,20 +281,53 @@ public:
         render_cards_.push_back(rcard);
     }
 
+    /*
+             : 
+              ,  
+               ,  
+        .     .
+    */
     const cv::Mat &render()
     {
-        render_background();
-        for (auto item : render_cards_)
+        DURAK_GAME_TRACE_SPAN("TableRenderer::render");
+        if (background_img_.empty() || background_img_.size() != table_size_)
+            render_background();
+
+        dirty_rects_.clear();
+        if (table_img_.empty() || table_img_.size() != table_size_)
         {
-            render_card(item);
+            table_img_.create(table_size_, CV_8UC3);
+            dirty_rects_.push_back(cv::Rect(cv::Point(0, 0), table_size_));
+        }
+        else
+            collect_dirty_rects();
+
+        for (const auto &rc : dirty_rects_)
+        {
+            background_img_(rc).copyTo(table_img_(rc));
+            for (const auto &item : render_cards_)
+                render_card(item, rc);
         }
+        prev_render_cards_ = render_cards_;
         //TODO text or something else
         return table_img_;
     }
+    //  ,   render();    -  
+    const std::vector<cv::Rect> &get_dirty_rects() const
+    {
+        return dirty_rects_;
+    }
+    //  render()   
+    void invalidate()
+    {
+        table_img_.release();
+    }
 public:
     void set_resource(const Resource &resource)
     {
         resource_ = resource;
+        background_img_.release();
+        invalidate();
     }
 
     void set_table_size(const cv::Size &sz)
@@ -173,82 +353,79 @@ private:
 
     cv::Size table_size_;
     cv::Mat table_img_;
+    cv::Mat background_img_; //      
 
     std::list<RenderCard> render_cards_;
+    std::list<RenderCard> prev_render_cards_;
+    std::vector<cv::Rect> dirty_rects_;
 
     void render_background()
     {
         const cv::Mat &background = resource_.get_background_image();
         if (background.empty())
         {
-            table_img_.create(table_size_, CV_8UC3);
-            table_img_ = cv::Scalar(0, 128, 0);
+            background_img_.create(table_size_, CV_8UC3);
+            background_img_ = cv::Scalar(0, 128, 0);
             return;
         }
             
-        table_img_ = cv::repeat(background, 
+        background_img_ = cv::repeat(background, 
                                 (int)(table_size_.height / background.rows) + 1,
-                                (int)(table_size_.width / background.cols) + 1).colRange(0, table_size_.width).rowRange(0, table_size_.height);
+                                (int)(table_size_.width / background.cols) + 1).colRange(0, table_size_.width).rowRange(0, table_size_.height).clone();
     }
-    void render_card(const RenderCard &card)
+    //          -    ,    
+    void collect_dirty_rects()
     {
-        const cv::Mat &card_img 
-            = (cards_common::CardsSuit::SuitNone == card.card_.suit_ || cards_common::CardsValue::ValueNone == card.card_.value_)
-            ? resource_.get_cards_back_image()
-            : resource_.get_card_image(card.card_);
-            
-        const cv::Mat *ptr_img = &card_img;
-        cv::Mat rotated;
-        switch (card.rotate_)
-        {
-        case rcNone:
-            break;
-        case rc90cw:
-            cv::rotate(*ptr_img, rotated, cv::ROTATE_90_CLOCKWISE);
-            ptr_img = &rotated;
-            break;
-        case rc180:
-            cv::rotate(*ptr_img, rotated, cv::ROTATE_180);
-            ptr_img = &rotated;
-            break;
-        case rc90ccw:
-            cv::rotate(*ptr_img, rotated, cv::ROTATE_90_COUNTERCLOCKWISE);
-            ptr_img = &rotated;
-            break;
-        }
-        cv::Mat sized;
-        if (card.rect_.size() != ptr_img->size())
+        auto cur = render_cards_.cbegin();
+        auto prev = prev_render_cards_.cbegin();
+        for (; cur != render_cards_.cend() || prev != prev_render_cards_.cend();)
         {
-            cv::resize(*ptr_img, sized, card.rect_.size());
-            ptr_img = &sized;
+            const bool has_cur = (cur != render_cards_.cend());
+            const bool has_prev = (prev != prev_render_cards_.cend());
+            if (!has_cur || !has_prev || !(*cur == *prev))
+            {
+                if (has_cur)
+                    add_dirty_rect(cur->rect_);
+                if (has_prev)
+                    add_dirty_rect(prev->rect_);
+            }
+            if (has_cur)
+                ++cur;
+            if (has_prev)
+                ++prev;
         }
-
-        cv::Rect crop_rc = card.rect_;
-        if (crop_rc.x < 0)
-        {
-            crop_rc.width += crop_rc.x;
-            crop_rc.x = -crop_rc.x;
-        }
-        else
-            crop_rc.x = 0;
-        if (crop_rc.y < 0)
+    }
+    //   ,      
+    void add_dirty_rect(cv::Rect rc)
+    {
+        rc &= cv::Rect(cv::Point(0, 0), table_size_);
+        if (rc.empty())
+            return;
+        for (size_t i = 0; i < dirty_rects_.size();)
         {
-            crop_rc.height += crop_rc.y;
-            crop_rc.y = -crop_rc.y;
+            if ((dirty_rects_[i] & rc).empty())
+            {
+                i++;
+                continue;
+            }
+            rc |= dirty_rects_[i];
+            dirty_rects_.erase(dirty_rects_.begin() + i);
+            i = 0;
         }
-        else
-            crop_rc.y = 0;
-
-        cv::Rect rc;
-        rc.x = std::max(card.rect_.x, 0);
-        rc.y = std::max(card.rect_.y, 0);
-
-        rc.width = crop_rc.width = std::min(rc.x + crop_rc.width, table_size_.width) - rc.x;
-        rc.height = crop_rc.height = std::min(rc.y + crop_rc.height, table_size_.height) - rc.y;
-        if (crop_rc.width <= 0 || crop_rc.height <= 0)
+        dirty_rects_.push_back(rc);
+    }
+    //     clip_rc (clip_rc  )
+    void render_card(const RenderCard &card, const cv::Rect &clip_rc)
+    {
+        const cv::Rect rc = card.rect_ & clip_rc;
+        if (rc.empty())
             return;
-        cv::Mat croped = (*ptr_img)(crop_rc);
-        croped.copyTo(table_img_(rc));
+        const cv::Mat &sprite = resource_.get_card_sprite(card.card_, card.rotate_, card.rect_.size());
+        if (sprite.empty())
+            return;
+
+        const cv::Rect crop_rc(rc.tl() - card.rect_.tl(), rc.size());
+        sprite(crop_rc).copyTo(table_img_(rc));
     }
 };
 };
\ No newline at end of file
@@ -1,10 +1,17 @@
 #pragma once
 
 #include "cards_common.hpp"
+#include "durak_game_card_tracker.hpp"
+#include "durak_game_latency.hpp"
+#include "durak_game_telemetry.hpp"
+#include "durak_game_trace.hpp"
 
 #include <array>
+#include <cassert>
+#include <chrono>
 #include <string>
 #include <memory>
+#include <stdexcept>
 
 namespace durak_game {
 constexpr size_t hands_start_amount = 6;
@@ -69,6 +76,12 @@ public:
     virtual const cards_common::CardSet& get_garbage() const = 0;
     virtual const cards_common::CardList& get_table() const = 0;
     virtual cards_common::CardDeck get_rest_cards() const = 0;
+
+    virtual cards_common::CardMask get_active_hand_mask() const = 0;
+    virtual cards_common::CardMask get_table_mask() const = 0;
+    virtual cards_common::CardMask get_known_hand_cards_mask(size_t hand_idx) const = 0;
+    virtual cards_common::CardMask get_unseen_cards_mask() const = 0;
+    virtual size_t get_rest_trumps_cnt() const = 0;
 public:
     cards_common::CardsSuit get_trump_suit() const {
         return get_trump_card().suit_;
@@ -110,6 +123,22 @@ public:
         }
         return valid_cards;
     }
+    cards_common::CardMask get_active_hand_mask_valid_for_attack() const {
+        const cards_common::CardMask hand = get_active_hand_mask();
+        if (0 == get_table_size())
+            return hand;
+        return hand & cards_common::same_values_mask(get_table_mask());
+    }
+    cards_common::CardMask get_active_hand_mask_valid_for_defend() const {
+        if (0 == get_table_size())
+            throw "Can't defend with empty table";
+        const cards_common::Card& last_card = get_table().back();
+        const cards_common::CardMask last = cards_common::card_mask(last_card);
+        cards_common::CardMask valid = cards_common::suit_mask(last_card.suit_) & ~(last | (last - 1));
+        if (last_card.suit_ != get_trump_suit())
+            valid |= cards_common::suit_mask(get_trump_suit());
+        return get_active_hand_mask() & valid;
+    }
 };
 
 template <size_t HandsCnt>
@@ -121,6 +150,26 @@ class GameRenderState;
 template <size_t HandsCnt>
 class Game;
 
+// сиды для случайных решений, генератор свой в каждом потоке,
+// Game::init сбрасывает его сидом игры, чтобы игра не зависела от потока
+inline std::default_random_engine& decision_seed_generator() {
+    thread_local std::default_random_engine generator;
+    return generator;
+}
+inline unsigned int make_decision_seed() {
+    return decision_seed_generator()();
+}
+
+// seed потока случайных чисел решения руки hand_idx в игре с seed game_seed (splitmix64),
+// поток руки не зависит от того, сколько чисел взяли решения других рук
+inline unsigned int decision_stream_seed(unsigned int game_seed, size_t hand_idx) {
+    uint64_t x = ((uint64_t)game_seed << 8) ^ (uint64_t)(hand_idx + 1);
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return (unsigned int)(x ^ (x >> 31));
+}
+
 template <size_t HandsCnt>
 class GameHandDecision
 {
@@ -132,6 +181,14 @@ public:
     virtual void game_reset(const GameStateConstPtr<HandsCnt>& state) = 0;
     virtual AttackAction attack_step(const GameStateConstPtr<HandsCnt>& state) = 0;
     virtual DefendAction defend_step(const GameStateConstPtr<HandsCnt>& state) = 0;
+
+    // решения с перебором должны учитывать budget, остальным хватает attack_step/defend_step
+    virtual AttackAction attack_step_with_budget(const GameStateConstPtr<HandsCnt>& state, const DecisionBudget& /*budget*/) {
+        return attack_step(state);
+    }
+    virtual DefendAction defend_step_with_budget(const GameStateConstPtr<HandsCnt>& state, const DecisionBudget& /*budget*/) {
+        return defend_step(state);
+    }
 };
 
 class GameChangingStageEvent
@@ -195,6 +252,7 @@ private:
             change_stage(state->get_current_stage());
         }
         GameStepResult run() {
+            DURAK_GAME_TRACE_SPAN("GameStep::run");
             GameStepResult result = GameStepResult::None;
             for (; result == GameStepResult::None;) {
                 result = make_step();
@@ -249,6 +307,7 @@ private:
                     throw std::runtime_error("Unable to attack by card");
                 game_.hands_[attack_hand_idx_].erase(action.card);
                 game_.table_.push_back(action.card);
+                game_.card_tracker_.play(attack_hand_idx_, action.card);
                 reset_attacker_hands_mask();
                 change_stage(Stage::DefendStage);
                 break;
@@ -276,6 +335,7 @@ private:
 
                 game_.hands_[defend_hand_idx_].erase(action.card);
                 game_.table_.push_back(action.card);
+                game_.card_tracker_.play(defend_hand_idx_, action.card);
                 if (game_.hands_[defend_hand_idx_].empty()) {
                     result = GameStepResult::Beat;
                 } else {
@@ -301,6 +361,7 @@ private:
                     throw std::runtime_error("Unable to attack by card");
                 game_.hands_[attack_hand_idx_].erase(action.card);
                 game_.table_.push_back(action.card);
+                game_.card_tracker_.play(attack_hand_idx_, action.card);
                 rest_append_cards_cnt_--;
                 reset_attacker_hands_mask();
                 break;
@@ -389,6 +450,22 @@ private:
         const cards_common::CardSet& get_garbage() const override { return game_.get_garbage(); }
         const cards_common::CardList& get_table() const override { return game_.get_table(); }
         cards_common::CardDeck get_rest_cards() const override { return game_.get_rest_cards(); }
+
+        cards_common::CardMask get_active_hand_mask() const override {
+            return game_.card_tracker_.get_hand_mask(game_.get_active_hand_idx());
+        }
+        cards_common::CardMask get_table_mask() const override {
+            return game_.card_tracker_.get_table_mask();
+        }
+        cards_common::CardMask get_known_hand_cards_mask(size_t hand_idx) const override {
+            return game_.card_tracker_.get_known_mask(hand_idx);
+        }
+        cards_common::CardMask get_unseen_cards_mask() const override {
+            return game_.card_tracker_.get_unseen_mask(game_.get_active_hand_idx());
+        }
+        size_t get_rest_trumps_cnt() const override {
+            return game_.card_tracker_.get_rest_trumps_cnt(game_.get_active_hand_idx());
+        }
     private:
         const Game<HandsCnt>& game_;
     };
@@ -398,7 +475,9 @@ public:
         , game_state_(std::make_shared<GameStateImpl>(*this))
         , game_step_(*this)
         , deck_(cards_common::CardDeckType::CardDeck36)
-        , trump_card_() {}
+        , trump_card_()
+        , decision_time_limit_(0)
+        , decision_latency_enabled_(false) {}
 
     virtual ~Game() {}
 public:
@@ -406,7 +485,7 @@ public:
         hand_decision_[hand_idx] = std::move(decision);
         hand_decision_[hand_idx]->set_to_game(hand_idx, *this);
     }
-    GameHandDecisionPtr& get_hand_decision() {
+    GameHandDecisionPtr& get_hand_decision(size_t hand_idx) {
         return hand_decision_[hand_idx];
     }
     void add_stage_changing_event(GameChangingStageEventPtr event) {
@@ -415,19 +494,43 @@ public:
     void add_step_event(GameStepEventPtr event) {
         step_events_.push_back(std::move(event));
     }
+    // 0 - без ограничения
+    void set_decision_time_limit(std::chrono::nanoseconds time_limit) {
+        decision_time_limit_ = time_limit;
+    }
+    void set_decision_latency_enabled(bool enabled) {
+        decision_latency_enabled_ = enabled;
+    }
+    const DecisionLatency& get_decision_latency(size_t hand_idx) const {
+        return decision_latency_[hand_idx];
+    }
+    void clear_decision_latency() {
+        for (auto& latency : decision_latency_)
+            latency.clear();
+    }
+    // пустая без DURAK_GAME_TELEMETRY
+    const GameTelemetry& get_telemetry() const {
+        return telemetry_;
+    }
+    void clear_telemetry() {
+        telemetry_.clear();
+    }
 public:
-    void init(int start_hand_idx = -1, unsigned int seed = (int)time(0)) {
+    // antithetic_deal - та же колода seed, но карты под козырем в обратном порядке:
+    // руки получают карты, которые в обычной раздаче пришли бы из колоды последними
+    void init(int start_hand_idx = -1, unsigned int seed = (int)time(0), bool antithetic_deal = false) {
         clear();
-        dial(seed);
+        dial(seed, antithetic_deal);
 
         start_hand_idx =
             (start_hand_idx < 0 || start_hand_idx >= HandsCnt)
             ? (int)get_hand_with_smaller_trump()
             : start_hand_idx;
 
+        card_tracker_.reset(trump_card_, hands_, table_, garbage_);
         game_step_.init((size_t)start_hand_idx);
         loser_hand_idx_ = -1;
-        decision_reset_game();
+        decision_reset_game(seed);
     }
     void init(const GameStateConstPtr<HandsCnt>& state, unsigned int seed = (int)time(0)) {
         trump_card_ = state->get_trump_card();
@@ -449,14 +552,22 @@ public:
                 hands_[hand].insert(deck_.pop_front());
             }
         }
+        // известные карты соперников после пересдачи не сохраняются
+        card_tracker_.reset(trump_card_, hands_, table_, garbage_);
         loser_hand_idx_ = -1;
         game_step_.init(state);
-        decision_reset_game();
+        decision_reset_game(seed);
     }
     // возвращает проигравшую руку, или -1 для ничьей
     int run() {
+        DURAK_GAME_TRACE_SPAN("Game::run");
+        size_t tricks_cnt = 0;
         for (;;) {
             GameStepResult step_result = game_step_.run();
+            if constexpr (game_telemetry_enabled) {
+                telemetry_.add_trick(table_.size(), GameStepResult::Take == step_result);
+                tricks_cnt++;
+            }
             switch (step_result) {
             case GameStepResult::Take:
                 table_to_hand(game_step_.get_defend_hand_idx());
@@ -479,6 +590,8 @@ public:
                 break;
             }
         }
+        if constexpr (game_telemetry_enabled)
+            telemetry_.add_game(tricks_cnt);
         return loser_hand_idx_;
     }
 public:
@@ -583,10 +696,12 @@ private:
         garbage_.clear();
         table_.clear();
     }
-    void dial(unsigned int seed)
+    void dial(unsigned int seed, bool antithetic_deal = false)
     {
         deck_.fill(cards_common::CardDeckType::CardDeck36);
         deck_.shuffle(seed);
+        if (antithetic_deal)
+            deck_.reverse_wo(hands_start_amount * HandsCnt); // козырь остается тем же
 
         pick_up_all(0);
 
@@ -598,7 +713,9 @@ private:
     {
         while (!deck_.empty() && hands_[hand_idx].size() < hands_start_amount)
         {
-            hands_[hand_idx].insert(deck_.pop_front());
+            const cards_common::Card card = deck_.pop_front();
+            hands_[hand_idx].insert(card);
+            card_tracker_.pick_up(hand_idx, card);
         }
     }
     void pick_up_all(size_t from_hand_idx)
@@ -667,20 +784,66 @@ private:
     void table_to_hand(size_t hand_idx) {
         hands_[hand_idx].insert(table_.begin(), table_.end());
         table_.clear();
+        card_tracker_.table_to_hand(hand_idx);
     }
     void table_to_garbage() {
         garbage_.insert(table_.begin(), table_.end());
         table_.clear();
+        card_tracker_.table_to_garbage();
     }
 private:
     AttackAction make_attack_decision(size_t hand_idx) {
-        return hand_decision_[hand_idx]->attack_step(game_state_);
+        return make_decision(hand_idx, [&](const DecisionBudget& budget) {
+            return hand_decision_[hand_idx]->attack_step_with_budget(game_state_, budget);
+        });
     }
     DefendAction make_defend_decision(size_t hand_idx) {
-        return hand_decision_[hand_idx]->defend_step(game_state_);
-    }
-    void decision_reset_game() {
+        return make_decision(hand_idx, [&](const DecisionBudget& budget) {
+            return hand_decision_[hand_idx]->defend_step_with_budget(game_state_, budget);
+        });
+    }
+    template <class DecisionStep>
+    auto make_decision(size_t hand_idx, DecisionStep step) {
+        DURAK_GAME_TRACE_SPAN(get_decision_span_name());
+        if (!decision_latency_enabled_ && !game_telemetry_enabled) {
+            if (std::chrono::nanoseconds::zero() == decision_time_limit_)
+                return step(DecisionBudget());
+            return step(DecisionBudget(DecisionBudget::Clock::now(), decision_time_limit_));
+        }
+        const DecisionBudget::Clock::time_point start = DecisionBudget::Clock::now();
+        auto action = step(DecisionBudget(start, decision_time_limit_));
+        const std::chrono::nanoseconds latency =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(DecisionBudget::Clock::now() - start);
+        if (decision_latency_enabled_)
+            decision_latency_[hand_idx].add(get_latency_stage(), latency);
+        if constexpr (game_telemetry_enabled)
+            telemetry_.add_decision(get_latency_stage(), latency);
+        return action;
+    }
+    DecisionLatency::LatencyStage get_latency_stage() const {
+        switch (get_current_stage()) {
+        case Stage::DefendStage:
+            return DecisionLatency::DefendLatency;
+        case Stage::AppendStage:
+            return DecisionLatency::AppendLatency;
+        default:
+            return DecisionLatency::AttackLatency;
+        }
+    }
+    const char* get_decision_span_name() const {
+        switch (get_current_stage()) {
+        case Stage::DefendStage:
+            return "decision defend";
+        case Stage::AppendStage:
+            return "decision append";
+        default:
+            return "decision attack";
+        }
+    }
+    // у каждой руки свой поток make_decision_seed, зависящий только от seed игры и номера руки
+    void decision_reset_game(unsigned int seed) {
         for (size_t hand_idx = 0; hand_idx < hand_decision_.size(); hand_idx++) {
+            decision_seed_generator().seed(decision_stream_seed(seed, hand_idx));
             hand_decision_[hand_idx]->game_reset(game_state_);
         }
     }
@@ -716,10 +879,16 @@ private:
     std::array<cards_common::CardSet, HandsCnt> hands_;
     cards_common::CardSet  garbage_;
     cards_common::CardList table_;
+    GameCardTracker<HandsCnt> card_tracker_;
 
     std::array<GameHandDecisionPtr, HandsCnt> hand_decision_;
     std::list<GameChangingStageEventPtr> changing_stage_events_;
     std::list<GameStepEventPtr> step_events_;
+
+    std::chrono::nanoseconds decision_time_limit_;
+    bool decision_latency_enabled_;
+    std::array<DecisionLatency, HandsCnt> decision_latency_;
+    GameTelemetry telemetry_;
 };
   
 template <size_t HandsCnt>
@@ -744,108 +913,61 @@ class GameRenderState
     private:
         const Game<HandsCnt> &game_;
     };
-};
 
-#include "cards_renderer.hpp"
-
-namespace durak_game {
-template <typename RenderState>
-class GameRenderer
+// копия того, что рисует GameRenderer: без ссылок на Game и без выделения памяти,
+// можно передавать между потоками по значению
+template <size_t HandsCnt>
+struct GameRenderSnapshot
 {
-public:
-    GameRenderer(const std::string &background_img_path,
-                 const std::string &cards_deck_img_path,
-                 const std::string &cards_back_img_path,
-                 const cv::Size &table_size)
-        : renderer_(background_img_path, cards_deck_img_path, cards_back_img_path, table_size)
-    {
-    }
-    virtual ~GameRenderer() {}
-public:
-    const cv::Mat &render(const RenderState &state)
+    static constexpr size_t max_table_cards = 36;
+
+    cards_common::Card trump_card;
+    size_t deck_size = 0;
+    std::array<cards_common::CardMask, HandsCnt> hands{};
+    std::array<cards_common::Card, max_table_cards> table{};
+    size_t table_size = 0;
+
+    GameRenderSnapshot() {}
+    explicit GameRenderSnapshot(const GameRenderState<HandsCnt> &state)
+        : trump_card(state.get_trump_card())
+        , deck_size(state.get_deck_size())
     {
-        renderer_.reset_cards();
-        if (!state.is_deck_empty())
-            draw_deck(state);
-
-        draw_hands(state);
-        draw_table(state);
-        return renderer_.render();
+        for (size_t hand = 0; hand < HandsCnt; hand++)
+            hands[hand] = cards_common::cards_mask(state.get_hand((int)hand));
+        for (const auto &card : state.get_table())
+        {
+            if (table_size < max_table_cards)
+                table[table_size++] = card;
+        }
     }
-private:
-    cards_renderer::TableRenderer renderer_;
+};
 
-    void draw_deck(const RenderState &state)
+// RenderState для GameRenderer из GameRenderSnapshot, собирается в потоке рисования
+template <size_t HandsCnt>
+class GameRenderSnapshotState
+{
+public:
+    explicit GameRenderSnapshotState(const GameRenderSnapshot<HandsCnt> &snapshot)
+        : snapshot_(snapshot)
+        , table_(snapshot.table.begin(), snapshot.table.begin() + snapshot.table_size)
     {
-        const cv::Size &table_sz = renderer_.get_table_size();
-        const cv::Size &card_sz = renderer_.get_card_size();
-        cv::Point temp;
-        temp.x = (table_sz.width / 5 - card_sz.height) / 2;
-        temp.y = table_sz.height / 2 - card_sz.width / 2;
-        renderer_.add_card(temp,
-            state.get_trump_card(),
-            cards_renderer::rc90cw);
-
-        if (1 < state.get_deck_size())
+        for (size_t hand = 0; hand < HandsCnt; hand++)
         {
-            temp.y = table_sz.height / 2 - card_sz.height / 2;
-            renderer_.add_card(temp,
-                cards_common::Card(cards_common::CardsSuit::SuitNone, cards_common::CardsValue::ValueNone));
+            for (cards_common::CardMask mask = snapshot.hands[hand]; 0 != mask; mask &= mask - 1)
+                hands_[hand].insert(cards_common::card_from_index(cards_common::mask_first_card_index(mask)));
         }
     }
-    void draw_hand(const cv::Rect &roi, const cards_common::CardSet &hand)
-    {
-        const int cards_cnt = (int)hand.size();
 
-        const cv::Size &card_sz = renderer_.get_card_size();
+    const cards_common::Card& get_trump_card() const { return snapshot_.trump_card; }
+    bool is_deck_empty() const { return 0 == snapshot_.deck_size; }
+    size_t get_deck_size() const { return snapshot_.deck_size; }
 
-        const int width_sm = roi.width - 2 * card_sz.width / 3;
-        const int shift = (cards_cnt <= 1) 
-                            ? 0 
-                            : (width_sm - card_sz.width) / (std::max(6, cards_cnt) - 1);
+    const cards_common::CardSet& get_hand(int hand) const { return hands_[hand]; }
 
-        cv::Point pt = roi.tl() + cv::Point(card_sz.width / 3, card_sz.height / 6);
-        for (auto item : hand)
-        {
-            renderer_.add_card(pt, item);
-            pt.x += shift;
-        }
-    }
-    void draw_hands(const RenderState &state)
-    {
-        const cv::Size &table_sz = renderer_.get_table_size();
-        cv::Rect rc(table_sz.width / 5, 0, 4 * table_sz.width / 5, table_sz.height / 3);
-        draw_hand(rc, state.get_hand(0));
-        rc.y = 2 * table_sz.height / 3;
-        draw_hand(rc, state.get_hand(1));
-    }
-    void draw_table (const RenderState &state)
-    {
-        const cv::Size &table_sz = renderer_.get_table_size();
-        const cv::Size &card_sz = renderer_.get_card_size();
-            
-        cv::Point tl(table_sz.width / 5, 
-                        table_sz.height / 3 + (table_sz.height / 3 - 6 * card_sz.height / 5));
-
-        const cards_common::CardList &table = state.get_table();
-        const int tbl_pair_cnt = ((int)table.size() + 1) / 2;
-        const int width_sm = (4 * table_sz.width / 5) - 2 * card_sz.width / 3;
-        const int shift = (tbl_pair_cnt <= 1)
-            ? 0
-            : (width_sm - card_sz.width) / (std::max(6, tbl_pair_cnt) - 1);
-
-        cv::Point pt[2] = { tl, tl + cv::Point(card_sz.width / 2, card_sz.height / 5) };
-        int delta = 0;
-        for (auto item : table)
-        {
-            renderer_.add_card(pt[delta], item);
-            delta = (delta + 1) % 2;
-            if (0 == delta)
-            {
-                pt[0].x += shift;
-                pt[1].x += shift;
-            }
-        }
-    }
+    const cards_common::CardList& get_table() const { return table_; }
+private:
+    const GameRenderSnapshot<HandsCnt> &snapshot_;
+    std::array<cards_common::CardSet, HandsCnt> hands_;
+    cards_common::CardList table_;
+};
 };
-};
\ No newline at end of file
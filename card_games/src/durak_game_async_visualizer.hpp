@@ -0,0 +1,196 @@
+#pragma once
+#include "durak_game.hpp"
+#include "durak_game_renderer.hpp"
+#include "durak_game_spsc_queue.hpp"
+
+#include "opencv2/highgui.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// AsyncGameVisualizer
+namespace durak_game {
+/*
+    Visualizer of a game on its own thread.
+
+    The game thread publishes GameRenderSnapshot values through a SpscQueue
+    and never waits: when the queue is full the snapshot is kept aside and
+    replaced by the next one. The render thread wakes up at a fixed frame
+    rate, takes all queued snapshots, draws only the newest one and passes
+    the frame to the sink, so the game runs at its own speed whatever the
+    display speed is.
+    publish() and stop() are called from one game thread.
+*/
+template <size_t HandsCnt>
+class AsyncGameVisualizer
+{
+public:
+    using FrameSink = std::function<void(const cv::Mat& /*frame*/)>;
+public:
+    AsyncGameVisualizer(const std::string &background_img_path,
+                        const std::string &cards_deck_img_path,
+                        const std::string &cards_back_img_path,
+                        const cv::Size &table_size,
+                        FrameSink sink,
+                        double fps = 10.,
+                        size_t queue_capacity = 64)
+        : renderer_(background_img_path, cards_deck_img_path, cards_back_img_path, table_size)
+        , sink_(std::move(sink))
+        , frame_period_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1. / fps)))
+        , queue_(queue_capacity)
+        , has_pending_(false)
+        , running_(false)
+        , rendered_frames_(0)
+        , dropped_snapshots_(0)
+    {
+    }
+    ~AsyncGameVisualizer() {
+        stop();
+    }
+
+    void start() {
+        if (running_.exchange(true))
+            return;
+        render_thread_ = std::thread(&AsyncGameVisualizer::render_loop, this);
+    }
+    // draws the newest published snapshot and stops the render thread
+    void stop() {
+        if (!running_.load())
+            return;
+        while (has_pending_ && !queue_.try_push(pending_))
+            std::this_thread::yield();
+        has_pending_ = false;
+        running_.store(false);
+        render_thread_.join();
+    }
+
+    // false - the queue is full, the snapshot waits for the next publish() or stop()
+    bool publish(const GameRenderSnapshot<HandsCnt> &snapshot) {
+        if (has_pending_) {
+            has_pending_ = false;
+            dropped_snapshots_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (queue_.try_push(snapshot))
+            return true;
+        pending_ = snapshot;
+        has_pending_ = true;
+        return false;
+    }
+    // event for Game::add_stage_changing_event, publishes the game on every stage change
+    std::unique_ptr<GameChangingStageEvent> make_stage_event(const Game<HandsCnt> &game) {
+        return std::unique_ptr<GameChangingStageEvent>(new PublishStageEvent(*this, game));
+    }
+
+    uint64_t get_rendered_frames() const {
+        return rendered_frames_.load(std::memory_order_relaxed);
+    }
+    // dropped by the full queue and skipped by the render thread
+    uint64_t get_dropped_snapshots() const {
+        return dropped_snapshots_.load(std::memory_order_relaxed);
+    }
+private:
+    class PublishStageEvent
+        : public GameChangingStageEvent
+    {
+    public:
+        PublishStageEvent(AsyncGameVisualizer &owner, const Game<HandsCnt> &game)
+            : owner_(owner)
+            , game_(game) {}
+        void stage_changing(Stage /*old_stage*/, Stage new_stage) override {
+            if (Stage::NoneStage != new_stage)
+                owner_.publish(GameRenderSnapshot<HandsCnt>(GameRenderState<HandsCnt>(game_)));
+        }
+    private:
+        AsyncGameVisualizer &owner_;
+        const Game<HandsCnt> &game_;
+    };
+
+    void render_loop() {
+        auto next_frame_time = std::chrono::steady_clock::now();
+        for (bool last_frame = false; !last_frame;) {
+            next_frame_time += frame_period_;
+            std::this_thread::sleep_until(next_frame_time);
+            last_frame = !running_.load(std::memory_order_acquire);
+            render_newest();
+        }
+    }
+    void render_newest() {
+        size_t popped_cnt = 0;
+        while (queue_.try_pop(snapshot_))
+            popped_cnt++;
+        if (0 == popped_cnt)
+            return;
+        dropped_snapshots_.fetch_add(popped_cnt - 1, std::memory_order_relaxed);
+        sink_(renderer_.render(GameRenderSnapshotState<HandsCnt>(snapshot_)));
+        rendered_frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+private:
+    GameRenderer<GameRenderSnapshotState<HandsCnt>> renderer_;
+    FrameSink sink_;
+    std::chrono::steady_clock::duration frame_period_;
+    SpscQueue<GameRenderSnapshot<HandsCnt>> queue_;
+    GameRenderSnapshot<HandsCnt> snapshot_; // render thread only
+    GameRenderSnapshot<HandsCnt> pending_;  // game thread only
+    bool has_pending_;
+
+    std::atomic<bool> running_;
+    std::thread render_thread_;
+    std::atomic<uint64_t> rendered_frames_;
+    std::atomic<uint64_t> dropped_snapshots_;
+};
+
+/*
+    Frames of the render thread to a HighGUI window. HighGUI calls stay on the
+    thread that owns the window (Win32 destroys a window with its thread, Qt
+    and Cocoa need the main thread): operator() on the render thread only
+    keeps the newest frame, show() and close() are called on the window thread.
+    Copies of the sink share the frame.
+*/
+class WindowSink
+{
+public:
+    explicit WindowSink(const std::string& window_name)
+        : window_name_(window_name)
+        , newest_(std::make_shared<NewestFrame>()) {}
+
+    void operator()(const cv::Mat& frame) const {
+        std::lock_guard<std::mutex> lock(newest_->mutex);
+        frame.copyTo(newest_->frame);
+        newest_->fresh = true;
+    }
+
+    // shows the newest frame, if any, and lets the window process its events for delay_ms
+    void show(int delay_ms = 1) {
+        bool fresh = false;
+        {
+            std::lock_guard<std::mutex> lock(newest_->mutex);
+            if (newest_->fresh) {
+                std::swap(newest_->frame, shown_frame_);
+                newest_->fresh = false;
+                fresh = true;
+            }
+        }
+        if (fresh)
+            cv::imshow(window_name_, shown_frame_);
+        cv::waitKey(delay_ms);
+    }
+    void close() {
+        cv::destroyWindow(window_name_);
+    }
+private:
+    struct NewestFrame {
+        std::mutex mutex;
+        cv::Mat frame;
+        bool fresh = false;
+    };
+    std::string window_name_;
+    std::shared_ptr<NewestFrame> newest_;
+    cv::Mat shown_frame_; // window thread only
+};
+} // namespace durak_game
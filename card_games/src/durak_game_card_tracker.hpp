@@ -0,0 +1,107 @@
+#pragma once
+
+#include "cards_common.hpp"
+
+#include <array>
+
+namespace durak_game {
+/*
+    Incremental tracker of card positions. Game updates it on every card
+    movement, so decisions can ask for known / unseen cards by O(1) mask
+    operations instead of rebuilding card sets.
+
+    known cards of hand - cards the hand picked up from the table (Take) and
+    the trump card if the hand has drawn it from the deck bottom.
+    unseen cards        - cards of the deck the viewer hand has never seen:
+    not in its hand, not on the table, not in the garbage, not known in other
+    hands and not the trump card.
+*/
+template <size_t HandsCnt>
+class GameCardTracker
+{
+public:
+    GameCardTracker()
+        : deck_mask_(cards_common::deck_mask(cards_common::CardDeckType::CardDeck36))
+        , trump_suit_mask_(0)
+        , trump_card_mask_(0)
+        , table_mask_(0)
+        , garbage_mask_(0)
+        , known_all_mask_(0)
+        , hands_mask_()
+        , known_mask_() {}
+
+    template <class _Hands, class _Table, class _Garbage>
+    void reset(const cards_common::Card& trump_card,
+               const _Hands& hands,
+               const _Table& table,
+               const _Garbage& garbage) {
+        trump_suit_mask_ = cards_common::suit_mask(trump_card.suit_);
+        trump_card_mask_ = cards_common::card_mask(trump_card);
+        table_mask_ = cards_common::cards_mask(table);
+        garbage_mask_ = cards_common::cards_mask(garbage);
+        known_all_mask_ = 0;
+        for (size_t i = 0; i < HandsCnt; i++) {
+            hands_mask_[i] = cards_common::cards_mask(hands[i]);
+            known_mask_[i] = 0;
+        }
+    }
+
+    void pick_up(size_t hand_idx, const cards_common::Card& card) {
+        const cards_common::CardMask mask = cards_common::card_mask(card);
+        hands_mask_[hand_idx] |= mask;
+        if (mask == trump_card_mask_) {
+            known_mask_[hand_idx] |= mask;
+            known_all_mask_ |= mask;
+        }
+    }
+    void play(size_t hand_idx, const cards_common::Card& card) {
+        const cards_common::CardMask mask = cards_common::card_mask(card);
+        hands_mask_[hand_idx] &= ~mask;
+        known_mask_[hand_idx] &= ~mask;
+        known_all_mask_ &= ~mask;
+        table_mask_ |= mask;
+    }
+    void table_to_hand(size_t hand_idx) {
+        hands_mask_[hand_idx] |= table_mask_;
+        known_mask_[hand_idx] |= table_mask_;
+        known_all_mask_ |= table_mask_;
+        table_mask_ = 0;
+    }
+    void table_to_garbage() {
+        garbage_mask_ |= table_mask_;
+        table_mask_ = 0;
+    }
+public:
+    cards_common::CardMask get_hand_mask(size_t hand_idx) const {
+        return hands_mask_[hand_idx];
+    }
+    cards_common::CardMask get_known_mask(size_t hand_idx) const {
+        return known_mask_[hand_idx];
+    }
+    cards_common::CardMask get_table_mask() const {
+        return table_mask_;
+    }
+    cards_common::CardMask get_garbage_mask() const {
+        return garbage_mask_;
+    }
+    cards_common::CardMask get_unseen_mask(size_t viewer_hand_idx) const {
+        return deck_mask_
+            & ~(hands_mask_[viewer_hand_idx] | table_mask_ | garbage_mask_ | known_all_mask_ | trump_card_mask_);
+    }
+    // trumps still in game outside of viewer hand (deck, other hands)
+    size_t get_rest_trumps_cnt(size_t viewer_hand_idx) const {
+        return cards_common::mask_cards_count(
+            trump_suit_mask_ & deck_mask_
+            & ~(hands_mask_[viewer_hand_idx] | table_mask_ | garbage_mask_));
+    }
+private:
+    cards_common::CardMask deck_mask_;
+    cards_common::CardMask trump_suit_mask_;
+    cards_common::CardMask trump_card_mask_;
+    cards_common::CardMask table_mask_;
+    cards_common::CardMask garbage_mask_;
+    cards_common::CardMask known_all_mask_;
+    std::array<cards_common::CardMask, HandsCnt> hands_mask_;
+    std::array<cards_common::CardMask, HandsCnt> known_mask_;
+};
+} // namespace durak_game
@@ -8,21 +8,53 @@ namespace durak_game {
 using RandomGen = std::default_random_engine;
 using UniformInt = std::uniform_int_distribution<int>;
 
+// все карты колоды + Pass/Take
+constexpr size_t max_actions_cnt = 37;
+
+template <typename Action>
+class ActionList
+{
+public:
+    using value_type = Action;
+    using iterator = Action*;
+    using const_iterator = const Action*;
+public:
+    ActionList()
+        : size_(0) {}
+
+    void push_back(const Action& action) {
+        actions_[size_++] = action;
+    }
+    size_t size() const { return size_; }
+    bool empty() const { return 0 == size_; }
+
+    Action& operator[](size_t idx) { return actions_[idx]; }
+    const Action& operator[](size_t idx) const { return actions_[idx]; }
+
+    iterator begin() { return actions_.data(); }
+    iterator end() { return actions_.data() + size_; }
+    const_iterator begin() const { return actions_.data(); }
+    const_iterator end() const { return actions_.data() + size_; }
+private:
+    std::array<Action, max_actions_cnt> actions_;
+    size_t size_;
+};
+
 template <typename Action, typename ActionType>
-std::vector<Action> get_valid_actions(const cards_common::CardSet& valid_cards, ActionType MeaningfulAction)
+ActionList<Action> get_valid_actions(cards_common::CardMask valid_cards, ActionType MeaningfulAction)
 {
-    std::vector<Action> actions;
-    for (const auto& card : valid_cards) {
-        actions.push_back({ MeaningfulAction, card });
+    ActionList<Action> actions;
+    for (; 0 != valid_cards; valid_cards &= valid_cards - 1) {
+        actions.push_back({ MeaningfulAction, cards_common::card_from_index(cards_common::mask_first_card_index(valid_cards)) });
     }
     return actions;
 }
 
 template <size_t HandsCnt>
-std::vector<AttackAction> get_valid_attack_actions(const GameStateConstPtr<HandsCnt>& state) {
-    std::vector<AttackAction> actions =
+ActionList<AttackAction> get_valid_attack_actions(const GameStateConstPtr<HandsCnt>& state) {
+    ActionList<AttackAction> actions =
         get_valid_actions<AttackAction, AttackActionType>(
-            state->get_active_hand_cards_valid_for_attack(),
+            state->get_active_hand_mask_valid_for_attack(),
             AttackActionType::Attack);
     if (0 < state->get_table_size())
         actions.push_back({ AttackActionType::Pass, {} });
@@ -30,15 +62,64 @@ std::vector<AttackAction> get_valid_attack_actions(const GameStateConstPtr<Hands
 }
 
 template <size_t HandsCnt>
-std::vector<DefendAction> get_valid_defend_actions(const GameStateConstPtr<HandsCnt>& state) {
-    std::vector<DefendAction> actions =
+ActionList<DefendAction> get_valid_defend_actions(const GameStateConstPtr<HandsCnt>& state) {
+    ActionList<DefendAction> actions =
         get_valid_actions<DefendAction, DefendActionType>(
-            state->get_active_hand_cards_valid_for_defend(),
+            state->get_active_hand_mask_valid_for_defend(),
             DefendActionType::Beat);
     actions.push_back({ DefendActionType::Take, {} });
     return actions;
 }
 
+// перебор допустимых действий без построения списка, порядок тот же что в get_valid_*_actions
+template <size_t HandsCnt, typename Fn>
+void for_each_valid_attack_action(const GameStateConstPtr<HandsCnt>& state, Fn fn) {
+    cards_common::CardMask valid_cards = state->get_active_hand_mask_valid_for_attack();
+    for (; 0 != valid_cards; valid_cards &= valid_cards - 1) {
+        fn(AttackAction{ AttackActionType::Attack, cards_common::card_from_index(cards_common::mask_first_card_index(valid_cards)) });
+    }
+    if (0 < state->get_table_size())
+        fn(AttackAction{ AttackActionType::Pass, {} });
+}
+
+template <size_t HandsCnt, typename Fn>
+void for_each_valid_defend_action(const GameStateConstPtr<HandsCnt>& state, Fn fn) {
+    cards_common::CardMask valid_cards = state->get_active_hand_mask_valid_for_defend();
+    for (; 0 != valid_cards; valid_cards &= valid_cards - 1) {
+        fn(DefendAction{ DefendActionType::Beat, cards_common::card_from_index(cards_common::mask_first_card_index(valid_cards)) });
+    }
+    fn(DefendAction{ DefendActionType::Take, {} });
+}
+
+// то же что get_valid_attack_actions(state)[idx % size], но без построения списка
+template <size_t HandsCnt>
+AttackAction get_valid_attack_action(const GameStateConstPtr<HandsCnt>& state, size_t idx) {
+    const cards_common::CardMask valid_cards = state->get_active_hand_mask_valid_for_attack();
+    const size_t cards_cnt = cards_common::mask_cards_count(valid_cards);
+    idx %= cards_cnt + (0 < state->get_table_size() ? 1 : 0);
+    if (idx < cards_cnt)
+        return { AttackActionType::Attack, cards_common::mask_nth_card(valid_cards, idx) };
+    return { AttackActionType::Pass, {} };
+}
+
+// то же что get_valid_defend_actions(state)[idx % size], но без построения списка
+template <size_t HandsCnt>
+DefendAction get_valid_defend_action(const GameStateConstPtr<HandsCnt>& state, size_t idx) {
+    const cards_common::CardMask valid_cards = state->get_active_hand_mask_valid_for_defend();
+    const size_t cards_cnt = cards_common::mask_cards_count(valid_cards);
+    idx %= cards_cnt + 1;
+    if (idx < cards_cnt)
+        return { DefendActionType::Beat, cards_common::mask_nth_card(valid_cards, idx) };
+    return { DefendActionType::Take, {} };
+}
+
+// равновероятный выбор карты из маски, mask не пустая
+template <typename Generator>
+cards_common::Card pick_random_card(cards_common::CardMask mask, Generator& generator) {
+    UniformInt uniform(0, (int)cards_common::mask_cards_count(mask) - 1);
+    return cards_common::mask_nth_card(mask, (size_t)uniform(generator));
+}
+
 template <size_t HandsCnt>
 class GameHandDecisionRandom
     : public GameHandDecision<HandsCnt>
@@ -63,20 +144,17 @@ public:
         rnd_generator_.seed(make_seed());
     }
     AttackAction attack_step(const GameStateConstPtr<HandsCnt>& state) override {
-        std::vector<AttackAction> actions = get_valid_attack_actions(state);
-        return actions[rnd_uniform_(rnd_generator_) % actions.size()];
+        return get_valid_attack_action(state, (size_t)rnd_uniform_(rnd_generator_));
     }
     DefendAction defend_step(const GameStateConstPtr<HandsCnt>& state) override {
-        std::vector<DefendAction> actions = get_valid_defend_actions(state);
-        return actions[rnd_uniform_(rnd_generator_) % actions.size()];
+        return get_valid_defend_action(state, (size_t)rnd_uniform_(rnd_generator_));
     }
 protected:
     RandomGen rnd_generator_;
     UniformInt rnd_uniform_;
 private:
     static unsigned int make_seed() {
-        static RandomGen g_seed_generator_;
-        return g_seed_generator_();
+        return make_decision_seed();
     }
 };
 } // namespace durak_game
@@ -0,0 +1,361 @@
+#pragma once
+
+#include "cards_common.hpp"
+
+#include "durak_game.hpp"
+#include "durak_game_decision_base.hpp"
+#include "durak_game_decision_less_card.hpp"
+
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+/*
+    Compile-time policy combinators.
+
+    Policy    - callable object, called with const GameStateConstPtr<HandsCnt>&,
+                returns AttackAction/DefendAction (complete policy) or
+                std::optional of action (partial policy, may have no answer).
+    Condition - callable object, called with const GameStateConstPtr<HandsCnt>&,
+                returns bool.
+
+    Policy may have game_reset(state) method, combinators forward it to all
+    nested policies. Policy may also be called with (state, const DecisionBudget&),
+    combinators called with the budget pass it to every nested policy that
+    takes it, so a search policy gets the budget at any depth. All calls are resolved at compile time, so combined policy
+    is inlined into GameHandDecisionPolicy::attack_step/defend_step.
+*/
+
+// policy helpers
+namespace durak_game {
+namespace policy {
+template <class Policy, class State, class = void>
+struct has_game_reset : std::false_type {};
+
+template <class Policy, class State>
+struct has_game_reset<Policy, State,
+    std::void_t<decltype(std::declval<Policy&>().game_reset(std::declval<const State&>()))>>
+    : std::true_type {};
+
+template <class Policy, class State>
+void game_reset(Policy& policy, const State& state) {
+    if constexpr (has_game_reset<Policy, State>::value)
+        policy.game_reset(state);
+}
+
+// policy(state), or policy(state, budget) for policies that take the budget
+template <class Policy, class State>
+decltype(auto) invoke(Policy& policy, const State& state) {
+    return policy(state);
+}
+template <class Policy, class State>
+decltype(auto) invoke(Policy& policy, const State& state, const DecisionBudget& budget) {
+    if constexpr (std::is_invocable_v<Policy&, const State&, const DecisionBudget&>)
+        return policy(state, budget);
+    else
+        return policy(state);
+}
+
+template <class T>
+struct is_optional : std::false_type {};
+
+template <class T>
+struct is_optional<std::optional<T>> : std::true_type {};
+} // namespace policy
+} // namespace durak_game
+
+// leaf policies and conditions
+namespace durak_game {
+namespace policy {
+// Function<attack_step_opt_less_card<2>>
+template <auto Fn>
+struct Function {
+    template <class State>
+    auto operator()(const State& state) const {
+        return Fn(state);
+    }
+};
+
+template <size_t HandsCnt>
+using AttackLessCard = Function<attack_step_opt_less_card<HandsCnt>>;
+
+template <size_t HandsCnt>
+using DefendLessCard = Function<defend_step_opt_less_card<HandsCnt>>;
+
+struct AttackPass {
+    template <class State>
+    AttackAction operator()(const State& /*state*/) const {
+        return { AttackActionType::Pass, {} };
+    }
+};
+
+struct DefendTake {
+    template <class State>
+    DefendAction operator()(const State& /*state*/) const {
+        return { DefendActionType::Take, {} };
+    }
+};
+
+// same choice as GameHandDecisionRandom
+class AttackRandom {
+public:
+    AttackRandom()
+        : rnd_generator_(make_decision_seed())
+        , rnd_uniform_(0, 36) {}
+
+    template <class State>
+    void game_reset(const State& /*state*/) {
+        rnd_generator_.seed(make_decision_seed());
+    }
+    template <class State>
+    AttackAction operator()(const State& state) {
+        return get_valid_attack_action(state, (size_t)rnd_uniform_(rnd_generator_));
+    }
+private:
+    RandomGen rnd_generator_;
+    UniformInt rnd_uniform_;
+};
+
+class DefendRandom {
+public:
+    DefendRandom()
+        : rnd_generator_(make_decision_seed())
+        , rnd_uniform_(0, 36) {}
+
+    template <class State>
+    void game_reset(const State& /*state*/) {
+        rnd_generator_.seed(make_decision_seed());
+    }
+    template <class State>
+    DefendAction operator()(const State& state) {
+        return get_valid_defend_action(state, (size_t)rnd_uniform_(rnd_generator_));
+    }
+private:
+    RandomGen rnd_generator_;
+    UniformInt rnd_uniform_;
+};
+
+struct DeckEmpty {
+    template <class State>
+    bool operator()(const State& state) const {
+        return 0 == state->get_deck_size();
+    }
+};
+
+struct TableEmpty {
+    template <class State>
+    bool operator()(const State& state) const {
+        return 0 == state->get_table_size();
+    }
+};
+
+// cards in hands, on table and in deck
+template <size_t CardsCnt>
+struct CardsInGameAtMost {
+    template <class State>
+    bool operator()(const State& state) const {
+        return cards_common::get_deck_size(cards_common::CardDeckType::CardDeck36)
+            - state->get_garbage_size() <= CardsCnt;
+    }
+};
+
+template <class Condition>
+struct Not {
+    template <class State>
+    bool operator()(const State& state) {
+        return !condition_(state);
+    }
+    Condition condition_;
+};
+} // namespace policy
+} // namespace durak_game
+
+// combinators
+namespace durak_game {
+namespace policy {
+// first policy with answer, all policies except the last must be partial
+template <class... Policies>
+class Fallback {
+    static_assert(0 < sizeof...(Policies), "Fallback needs at least one policy");
+public:
+    template <class State>
+    void game_reset(const State& state) {
+        std::apply([&](auto&... policies) { (policy::game_reset(policies, state), ...); }, policies_);
+    }
+    template <class State>
+    auto operator()(const State& state) {
+        return call<0>(state);
+    }
+    template <class State>
+    auto operator()(const State& state, const DecisionBudget& budget) {
+        return call<0>(state, budget);
+    }
+private:
+    template <size_t Idx, class State, class... Budget>
+    auto call(const State& state, const Budget&... budget) {
+        using Last = std::tuple_element_t<sizeof...(Policies) - 1, std::tuple<Policies...>>;
+        using Result = std::decay_t<decltype(policy::invoke(std::declval<Last&>(), state, budget...))>;
+
+        if constexpr (Idx + 1 == sizeof...(Policies)) {
+            return policy::invoke(std::get<Idx>(policies_), state, budget...);
+        } else {
+            auto result = policy::invoke(std::get<Idx>(policies_), state, budget...);
+            static_assert(is_optional<decltype(result)>::value, "Only the last policy of Fallback may be complete");
+            if (result)
+                return Result(*result);
+            return Result(call<Idx + 1>(state, budget...));
+        }
+    }
+private:
+    std::tuple<Policies...> policies_;
+};
+
+// partial policy: answer of Policy only if Condition holds
+template <class Condition, class Policy>
+class OnlyIf {
+public:
+    template <class State>
+    void game_reset(const State& state) {
+        policy::game_reset(condition_, state);
+        policy::game_reset(policy_, state);
+    }
+    template <class State>
+    auto operator()(const State& state) {
+        return call(state);
+    }
+    template <class State>
+    auto operator()(const State& state, const DecisionBudget& budget) {
+        return call(state, budget);
+    }
+private:
+    template <class State, class... Budget>
+    auto call(const State& state, const Budget&... budget) {
+        using Result = std::decay_t<decltype(policy::invoke(policy_, state, budget...))>;
+        if constexpr (is_optional<Result>::value) {
+            return condition_(state) ? policy::invoke(policy_, state, budget...) : Result();
+        } else {
+            return condition_(state)
+                ? std::optional<Result>(policy::invoke(policy_, state, budget...))
+                : std::optional<Result>();
+        }
+    }
+private:
+    Condition condition_;
+    Policy policy_;
+};
+
+// stage-conditional policy, e.g. When<DeckEmpty, Endgame, Opening>
+template <class Condition, class Then, class Else>
+class When {
+public:
+    template <class State>
+    void game_reset(const State& state) {
+        policy::game_reset(condition_, state);
+        policy::game_reset(then_, state);
+        policy::game_reset(else_, state);
+    }
+    template <class State>
+    auto operator()(const State& state) {
+        if (condition_(state))
+            return then_(state);
+        return else_(state);
+    }
+    template <class State>
+    auto operator()(const State& state, const DecisionBudget& budget) {
+        if (condition_(state))
+            return policy::invoke(then_, state, budget);
+        return policy::invoke(else_, state, budget);
+    }
+private:
+    Condition condition_;
+    Then then_;
+    Else else_;
+};
+
+template <size_t MaxCardsInGame, class Solver, class Heuristic>
+using SolverIfCheap = When<CardsInGameAtMost<MaxCardsInGame>, Solver, Heuristic>;
+
+// Explore with probability EpsNum / EpsDen, Main otherwise
+template <unsigned EpsNum, unsigned EpsDen, class Main, class Explore>
+class EpsilonMix {
+    static_assert(0 < EpsDen && EpsNum <= EpsDen, "Invalid epsilon");
+public:
+    EpsilonMix()
+        : rnd_generator_(make_decision_seed())
+        , rnd_uniform_(0, (int)EpsDen - 1) {}
+
+    template <class State>
+    void game_reset(const State& state) {
+        rnd_generator_.seed(make_decision_seed());
+        policy::game_reset(main_, state);
+        policy::game_reset(explore_, state);
+    }
+    template <class State>
+    auto operator()(const State& state) {
+        if (rnd_uniform_(rnd_generator_) < (int)EpsNum)
+            return explore_(state);
+        return main_(state);
+    }
+    template <class State>
+    auto operator()(const State& state, const DecisionBudget& budget) {
+        if (rnd_uniform_(rnd_generator_) < (int)EpsNum)
+            return policy::invoke(explore_, state, budget);
+        return policy::invoke(main_, state, budget);
+    }
+private:
+    RandomGen rnd_generator_;
+    UniformInt rnd_uniform_;
+    Main main_;
+    Explore explore_;
+};
+} // namespace policy
+} // namespace durak_game
+
+// GameHandDecisionPolicy
+namespace durak_game {
+template <
+    size_t HandsCnt,
+    const char* GameHandDecisionName,
+    class AttackPolicy,
+    class DefendPolicy>
+class GameHandDecisionPolicy final
+    : public GameHandDecision<HandsCnt>
+{
+public:
+    static std::string decision_name() {
+        return GameHandDecisionName;
+    };
+public:
+    GameHandDecisionPolicy()
+    {}
+
+    void set_to_game(size_t /*hand_idx*/, Game<HandsCnt>& /*owner_game*/) override {}
+    void game_reset(const GameStateConstPtr<HandsCnt>& state) override {
+        policy::game_reset(attack_, state);
+        policy::game_reset(defend_, state);
+    }
+    AttackAction attack_step(const GameStateConstPtr<HandsCnt>& state) override {
+        return attack_(state);
+    }
+    DefendAction defend_step(const GameStateConstPtr<HandsCnt>& state) override {
+        return defend_(state);
+    }
+    // policy called with (state, budget) gets the decision budget
+    AttackAction attack_step_with_budget(const GameStateConstPtr<HandsCnt>& state, const DecisionBudget& budget) override {
+        return policy::invoke(attack_, state, budget);
+    }
+    DefendAction defend_step_with_budget(const GameStateConstPtr<HandsCnt>& state, const DecisionBudget& budget) override {
+        return policy::invoke(defend_, state, budget);
+    }
+private:
+    AttackPolicy attack_;
+    DefendPolicy defend_;
+};
+
+const char GameHandDecisionEpsLessCardName[] = "GameHandDecisionEpsLessCard";
+template <size_t HandsCnt>
+using GameHandDecisionEpsLessCard =
+    GameHandDecisionPolicy<HandsCnt, GameHandDecisionEpsLessCardName,
+        policy::EpsilonMix<1, 20, policy::AttackLessCard<HandsCnt>, policy::AttackRandom>,
+        policy::EpsilonMix<1, 20, policy::DefendLessCard<HandsCnt>, policy::DefendRandom>>;
+} // namespace durak_game
@@ -0,0 +1,98 @@
+#pragma once
+#include "durak_game.hpp"
+#include "durak_game_decision_base.hpp"
+#include "durak_game_decision_less_card.hpp"
+#include "durak_game_decision_policy.hpp"
+#include "durak_game_opening_book.hpp"
+#include "durak_game_statistic.hpp"
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// DecisionRegistry
+namespace durak_game {
+/*
+    Named factories of GameHandDecision<2> for runtime selection of decisions.
+
+    add<Decision>() registers a decision under its decision_name(),
+    make_statistician builds a DecisionStatistician of any pair of
+    registered names from their factories.
+    add_opening_book() registers the decisions of the project once more behind
+    the opening book of the file, as OpeningBook(<decision>).
+*/
+class DecisionRegistry
+{
+public:
+    void add(const std::string& name, GameHandDecisionFactory factory) {
+        decisions_[name] = std::move(factory);
+    }
+    template <class GameHandDecisionType>
+    void add() {
+        add(GameHandDecisionType::decision_name(), make_decision_factory<GameHandDecisionType>());
+    }
+
+    // throws when the book can not be loaded
+    void add_opening_book(const std::string& book_path) {
+        const auto book = opening_book::OpeningBook::shared(book_path);
+        if (book->empty() || 2 != book->get_hands_cnt())
+            throw std::runtime_error("Unable to use opening book: " + book_path);
+        add_with_book<GameHandDecisionRandom<2>>(book);
+        add_with_book<GameHandDecisionAttackLessCard<2>>(book);
+        add_with_book<GameHandDecisionDefendLessCard<2>>(book);
+        add_with_book<GameHandDecisionAttackDefendLessCard<2>>(book);
+        add_with_book<GameHandDecisionEpsLessCard<2>>(book);
+    }
+
+    bool contains(const std::string& name) const {
+        return decisions_.end() != decisions_.find(name);
+    }
+    const GameHandDecisionFactory& factory(const std::string& name) const {
+        auto it = decisions_.find(name);
+        if (decisions_.end() == it)
+            throw std::invalid_argument("Unknown decision: " + name);
+        return it->second;
+    }
+    std::vector<std::string> names() const {
+        std::vector<std::string> result;
+        for (const auto& item : decisions_)
+            result.push_back(item.first);
+        return result;
+    }
+
+    std::unique_ptr<DecisionStatistician> make_statistician(
+        const std::string& first, const std::string& second, size_t threads_cnt = 0) const
+    {
+        return std::unique_ptr<DecisionStatistician>(
+            new DecisionStatistician(first, factory(first), second, factory(second), threads_cnt));
+    }
+
+    // registry with all decisions of the project
+    static DecisionRegistry& instance() {
+        static DecisionRegistry registry = make_default();
+        return registry;
+    }
+private:
+    template <class GameHandDecisionType>
+    void add_with_book(const std::shared_ptr<const opening_book::OpeningBook>& book) {
+        using BookDecision = GameHandDecisionOpeningBook<2, GameHandDecisionType>;
+        add(BookDecision::decision_name(), [book]() {
+            return std::unique_ptr<GameHandDecision<2>>(new BookDecision(book));
+        });
+    }
+    static DecisionRegistry make_default() {
+        DecisionRegistry registry;
+        registry.add<GameHandDecisionRandom<2>>();
+        registry.add<GameHandDecisionAttackLessCard<2>>();
+        registry.add<GameHandDecisionDefendLessCard<2>>();
+        registry.add<GameHandDecisionAttackDefendLessCard<2>>();
+        registry.add<GameHandDecisionEpsLessCard<2>>();
+        return registry;
+    }
+private:
+    std::map<std::string, GameHandDecisionFactory> decisions_;
+};
+} // namespace durak_game
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// DecisionBudget
+namespace durak_game {
+/*
+    Time budget of one decision. Search-based decisions should check expired()
+    and return the best action found so far. Default budget is unlimited.
+*/
+class DecisionBudget
+{
+public:
+    using Clock = std::chrono::steady_clock;
+public:
+    DecisionBudget()
+        : deadline_(Clock::time_point::max()) {}
+    DecisionBudget(Clock::time_point start, Clock::duration time_limit)
+        : deadline_(Clock::duration::zero() == time_limit ? Clock::time_point::max() : start + time_limit) {}
+
+    bool is_limited() const {
+        return Clock::time_point::max() != deadline_;
+    }
+    bool expired() const {
+        return is_limited() && Clock::now() >= deadline_;
+    }
+    Clock::time_point get_deadline() const {
+        return deadline_;
+    }
+    Clock::duration get_rest_time() const {
+        if (!is_limited())
+            return Clock::duration::max();
+        const Clock::time_point now = Clock::now();
+        return (now < deadline_) ? deadline_ - now : Clock::duration::zero();
+    }
+private:
+    Clock::time_point deadline_;
+};
+} // namespace durak_game
+
+// LatencyHistogram
+namespace durak_game {
+/*
+    HDR-style histogram of latencies in nanoseconds: values below 8 have own
+    bucket, above - 8 linear sub-buckets for every power of two (precision ~12%).
+*/
+class LatencyHistogram
+{
+    static constexpr size_t sub_bucket_bits = 3;
+    static constexpr size_t sub_buckets_cnt = size_t(1) << sub_bucket_bits;
+public:
+    static constexpr size_t buckets_cnt = (64 - sub_bucket_bits + 1) * sub_buckets_cnt;
+public:
+    LatencyHistogram()
+        : counts_()
+        , count_(0)
+        , sum_(0)
+        , max_(0) {}
+
+    void add(uint64_t value) {
+        counts_[bucket_index(value)]++;
+        count_++;
+        sum_ += value;
+        if (max_ < value)
+            max_ = value;
+    }
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < buckets_cnt; i++)
+            counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        if (max_ < other.max_)
+            max_ = other.max_;
+    }
+    void clear() {
+        counts_.fill(0);
+        count_ = sum_ = max_ = 0;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return (0 == count_) ? 0. : (double)sum_ / (double)count_; }
+    uint64_t bucket_count(size_t idx) const { return counts_[idx]; }
+
+    // upper bound of the bucket with percentile (0..100)
+    uint64_t percentile(double percent) const {
+        if (0 == count_)
+            return 0;
+        uint64_t rank = (uint64_t)(percent / 100. * (double)count_ + 0.5);
+        if (rank < 1)
+            rank = 1;
+        uint64_t acc = 0;
+        for (size_t i = 0; i < buckets_cnt; i++) {
+            acc += counts_[i];
+            if (acc >= rank)
+                return std::min(bucket_upper_value(i), max_);
+        }
+        return max_;
+    }
+
+    static size_t bucket_index(uint64_t value) {
+        if (value < sub_buckets_cnt)
+            return (size_t)value;
+        const size_t shift = highest_bit_index(value) - sub_bucket_bits;
+        return (shift + 1) * sub_buckets_cnt + (size_t)((value >> shift) & (sub_buckets_cnt - 1));
+    }
+    static uint64_t bucket_lower_value(size_t idx) {
+        if (idx < sub_buckets_cnt)
+            return idx;
+        const size_t shift = idx / sub_buckets_cnt - 1;
+        return (uint64_t)(sub_buckets_cnt + idx % sub_buckets_cnt) << shift;
+    }
+    static uint64_t bucket_upper_value(size_t idx) {
+        if (idx < sub_buckets_cnt)
+            return idx;
+        const size_t shift = idx / sub_buckets_cnt - 1;
+        return bucket_lower_value(idx) + ((uint64_t(1) << shift) - 1);
+    }
+private:
+    static size_t highest_bit_index(uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long idx = 0;
+        _BitScanReverse64(&idx, value);
+        return (size_t)idx;
+#else
+        return (size_t)(63 - __builtin_clzll(value));
+#endif
+    }
+private:
+    std::array<uint64_t, buckets_cnt> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+};
+} // namespace durak_game
+
+// DecisionLatency
+namespace durak_game {
+// latency histograms of one hand decision by stage: attack, defend, append
+class DecisionLatency
+{
+public:
+    enum LatencyStage {
+        AttackLatency,
+        DefendLatency,
+        AppendLatency,
+        LatencyStageCnt
+    };
+public:
+    void add(LatencyStage stage, std::chrono::nanoseconds latency) {
+        histograms_[stage].add((uint64_t)latency.count());
+    }
+    void merge(const DecisionLatency& other) {
+        for (size_t i = 0; i < LatencyStageCnt; i++)
+            histograms_[i].merge(other.histograms_[i]);
+    }
+    void clear() {
+        for (auto& histogram : histograms_)
+            histogram.clear();
+    }
+    uint64_t count() const {
+        uint64_t cnt = 0;
+        for (const auto& histogram : histograms_)
+            cnt += histogram.count();
+        return cnt;
+    }
+    const LatencyHistogram& get_histogram(LatencyStage stage) const {
+        return histograms_[stage];
+    }
+
+    static const char* stage_name(LatencyStage stage) {
+        switch (stage) {
+        case AttackLatency:
+            return "attack";
+        case DefendLatency:
+            return "defend";
+        case AppendLatency:
+            return "append";
+        default:
+            return "";
+        }
+    }
+
+    friend std::ostream& operator<< (std::ostream& stream, const DecisionLatency& latency) {
+        for (size_t i = 0; i < LatencyStageCnt; i++) {
+            const LatencyHistogram& histogram = latency.histograms_[i];
+            if (0 == histogram.count())
+                continue;
+            stream
+                << "  " << std::left << std::setw(8) << stage_name((LatencyStage)i) << std::right
+                << " count: " << std::setw(9) << histogram.count()
+                << " mean: " << std::setw(8) << (uint64_t)histogram.mean()
+                << " p50: " << std::setw(8) << histogram.percentile(50.)
+                << " p99: " << std::setw(8) << histogram.percentile(99.)
+                << " p99.9: " << std::setw(8) << histogram.percentile(99.9)
+                << " max: " << std::setw(9) << histogram.max()
+                << std::endl;
+        }
+        return stream;
+    }
+private:
+    std::array<LatencyHistogram, LatencyStageCnt> histograms_;
+};
+} // namespace durak_game
@@ -0,0 +1,110 @@
+#pragma once
+#include "durak_game.hpp"
+#include "durak_game_spsc_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// LiveGameSampler
+namespace durak_game {
+/*
+    Snapshots of a few live games of simulation workers for a monitor.
+
+    Every tile is bound to one worker Game by a stage event. The event counts
+    stage changes and looks at the clock only every sample_every-th change;
+    at most once per min_period it copies the game into a GameRenderSnapshot
+    and pushes it to the tile queue without waiting, a snapshot that does not
+    fit is dropped. The monitor thread takes the newest snapshot of a tile.
+*/
+class LiveGameSampler
+{
+    using Clock = std::chrono::steady_clock;
+public:
+    struct Params {
+        size_t tiles_cnt = 4;
+        std::chrono::milliseconds min_period = std::chrono::milliseconds(100); // per tile
+        unsigned int sample_every = 8; // stage changes between clock checks
+    };
+public:
+    explicit LiveGameSampler(const Params& params)
+        : params_(params)
+        , attached_tiles_cnt_(0)
+    {
+        for (size_t i = 0; i < params_.tiles_cnt; i++)
+            tiles_.emplace_back(std::make_shared<Tile>());
+    }
+
+    size_t tiles_cnt() const {
+        return tiles_.size();
+    }
+    // binds the next free tile to game; nullptr when all tiles are bound
+    std::unique_ptr<GameChangingStageEvent> make_stage_event(const Game<2>& game) {
+        const size_t tile_idx = attached_tiles_cnt_.fetch_add(1);
+        if (tiles_.size() <= tile_idx)
+            return nullptr;
+        return std::unique_ptr<GameChangingStageEvent>(new SampleStageEvent(tiles_[tile_idx], game, params_));
+    }
+
+    // monitor thread: newest snapshot of the tile since the previous call
+    bool take_snapshot(size_t tile_idx, GameRenderSnapshot<2>& snapshot) {
+        bool taken = false;
+        while (tiles_[tile_idx]->queue.try_pop(snapshot))
+            taken = true;
+        return taken;
+    }
+    uint64_t get_published_snapshots() const {
+        uint64_t published = 0;
+        for (const auto& tile : tiles_)
+            published += tile->published.load(std::memory_order_relaxed);
+        return published;
+    }
+private:
+    struct Tile {
+        Tile()
+            : queue(2)
+            , published(0) {}
+        SpscQueue<GameRenderSnapshot<2>> queue;
+        std::atomic<uint64_t> published;
+    };
+
+    class SampleStageEvent
+        : public GameChangingStageEvent
+    {
+    public:
+        SampleStageEvent(std::shared_ptr<Tile> tile, const Game<2>& game, const Params& params)
+            : tile_(std::move(tile))
+            , game_(game)
+            , min_period_(params.min_period)
+            , sample_every_(std::max(1u, params.sample_every))
+            , stage_changes_cnt_(0)
+            , next_sample_time_() {}
+
+        void stage_changing(Stage /*old_stage*/, Stage new_stage) override {
+            if (Stage::NoneStage == new_stage || ++stage_changes_cnt_ < sample_every_)
+                return;
+            stage_changes_cnt_ = 0;
+            const Clock::time_point now = Clock::now();
+            if (now < next_sample_time_)
+                return;
+            next_sample_time_ = now + min_period_;
+            if (tile_->queue.try_push(GameRenderSnapshot<2>(GameRenderState<2>(game_))))
+                tile_->published.fetch_add(1, std::memory_order_relaxed);
+        }
+    private:
+        std::shared_ptr<Tile> tile_; // the game may outlive the sampler
+        const Game<2>& game_;
+        Clock::duration min_period_;
+        unsigned int sample_every_;
+        unsigned int stage_changes_cnt_;
+        Clock::time_point next_sample_time_;
+    };
+private:
+    Params params_;
+    std::vector<std::shared_ptr<Tile>> tiles_;
+    std::atomic<size_t> attached_tiles_cnt_;
+};
+} // namespace durak_game
@@ -0,0 +1,185 @@
+#pragma once
+#include "durak_game.hpp"
+#include "durak_game_renderer.hpp"
+#include "durak_game_live_sampler.hpp"
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// MosaicMonitor
+namespace durak_game {
+/*
+    Mosaic of live games from a LiveGameSampler, drawn on its own thread.
+
+    Every tile has own GameRenderer of the full table size and a ROI of the
+    mosaic frame. The render thread wakes up at a fixed frame rate, renders
+    the tiles with a new snapshot and puts them into their ROIs: unscaled
+    tiles copy only the dirty rectangles, scaled ones are resized. The frame
+    goes to the sink only when some tile changed.
+*/
+class MosaicMonitor
+{
+public:
+    using FrameSink = std::function<void(const cv::Mat& /*frame*/)>;
+
+    struct Params {
+        std::string background_img_path;
+        std::string cards_deck_img_path = "../res/cards_deck_sm.png";
+        std::string cards_back_img_path = "../res/back_sm.png";
+        cv::Size table_size = cv::Size(1000, 600);
+        size_t columns_cnt = 2;
+        double tile_scale = 0.5; // tile size in the mosaic relative to table_size
+        int spacing = 4;
+        double fps = 2.;
+    };
+public:
+    MosaicMonitor(std::shared_ptr<LiveGameSampler> sampler, const Params& params, FrameSink sink)
+        : sampler_(std::move(sampler))
+        , params_(params)
+        , sink_(std::move(sink))
+        , running_(false)
+        , rendered_frames_(0)
+    {
+        const size_t tiles_cnt = sampler_->tiles_cnt();
+        const size_t columns_cnt = std::max<size_t>(1, std::min(params_.columns_cnt, tiles_cnt));
+        const size_t rows_cnt = (tiles_cnt + columns_cnt - 1) / columns_cnt;
+        const cv::Size tile_size(
+            std::max(1, (int)(params_.table_size.width * params_.tile_scale)),
+            std::max(1, (int)(params_.table_size.height * params_.tile_scale)));
+        mosaic_.create(
+            (int)rows_cnt * (tile_size.height + params_.spacing) + params_.spacing,
+            (int)columns_cnt * (tile_size.width + params_.spacing) + params_.spacing,
+            CV_8UC3);
+        mosaic_ = cv::Scalar(32, 32, 32);
+        for (size_t i = 0; i < tiles_cnt; i++) {
+            const cv::Point tl(
+                params_.spacing + (int)(i % columns_cnt) * (tile_size.width + params_.spacing),
+                params_.spacing + (int)(i / columns_cnt) * (tile_size.height + params_.spacing));
+            tiles_.emplace_back(new Tile(params_, cv::Rect(tl, tile_size)));
+        }
+    }
+    ~MosaicMonitor() {
+        if (running_.exchange(false))
+            render_thread_.join();
+    }
+
+    void start() {
+        if (running_.exchange(true))
+            return;
+        render_thread_ = std::thread(&MosaicMonitor::render_loop, this);
+    }
+    // draws the newest snapshots and stops the render thread, rethrows an error of the sink
+    void stop() {
+        if (!running_.exchange(false))
+            return;
+        render_thread_.join();
+        if (render_error_)
+            std::rethrow_exception(render_error_);
+    }
+
+    uint64_t get_rendered_frames() const {
+        return rendered_frames_.load(std::memory_order_relaxed);
+    }
+private:
+    struct Tile {
+        Tile(const Params& params, const cv::Rect& roi)
+            : renderer(params.background_img_path, params.cards_deck_img_path, params.cards_back_img_path, params.table_size)
+            , roi(roi) {}
+        GameRenderer<GameRenderSnapshotState<2>> renderer;
+        cv::Rect roi;
+    };
+
+    void render_loop() {
+        const auto frame_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1. / params_.fps));
+        auto next_frame_time = std::chrono::steady_clock::now();
+        try {
+            for (bool last_frame = false; !last_frame;) {
+                next_frame_time += frame_period;
+                std::this_thread::sleep_until(next_frame_time);
+                last_frame = !running_.load(std::memory_order_acquire);
+                render_mosaic();
+            }
+        }
+        catch (...) {
+            render_error_ = std::current_exception();
+        }
+    }
+    void render_mosaic() {
+        bool changed = false;
+        for (size_t i = 0; i < tiles_.size(); i++) {
+            if (!sampler_->take_snapshot(i, snapshot_))
+                continue;
+            Tile& tile = *tiles_[i];
+            const cv::Mat& table_img = tile.renderer.render(GameRenderSnapshotState<2>(snapshot_));
+            cv::Mat tile_img = mosaic_(tile.roi);
+            if (table_img.size() == tile_img.size()) {
+                for (const auto& rc : tile.renderer.get_dirty_rects())
+                    table_img(rc).copyTo(tile_img(rc));
+            }
+            else
+                cv::resize(table_img, tile_img, tile_img.size(), 0., 0., cv::INTER_AREA);
+            changed = true;
+        }
+        if (!changed)
+            return;
+        sink_(mosaic_);
+        rendered_frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+private:
+    std::shared_ptr<LiveGameSampler> sampler_;
+    Params params_;
+    FrameSink sink_;
+    std::vector<std::unique_ptr<Tile>> tiles_;
+    cv::Mat mosaic_;
+    GameRenderSnapshot<2> snapshot_;
+
+    std::atomic<bool> running_;
+    std::thread render_thread_;
+    std::exception_ptr render_error_;
+    std::atomic<uint64_t> rendered_frames_;
+};
+
+/*
+    Every frame overwrites one image file. The frame is written to a temporary
+    file next to it and renamed, so a viewer never reads a half-written image.
+*/
+class ImageFileSink
+{
+public:
+    explicit ImageFileSink(const std::string& path)
+        : path_(path)
+    {
+        const size_t ext_pos = path_.rfind('.');
+        if (std::string::npos == ext_pos)
+            throw std::invalid_argument("Image path needs an extension: " + path_);
+        temp_path_ = path_.substr(0, ext_pos) + ".tmp" + path_.substr(ext_pos);
+    }
+
+    void operator()(const cv::Mat& frame) const {
+        if (!cv::imwrite(temp_path_, frame))
+            throw std::runtime_error("Unable to write image: " + temp_path_);
+#ifdef _WIN32
+        // rename does not replace existing file on Windows
+        std::remove(path_.c_str());
+#endif
+        if (0 != std::rename(temp_path_.c_str(), path_.c_str()))
+            throw std::runtime_error("Unable to write image: " + path_);
+    }
+private:
+    std::string path_;
+    std::string temp_path_;
+};
+} // namespace durak_game
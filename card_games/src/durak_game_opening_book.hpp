@@ -0,0 +1,388 @@
+#pragma once
+
+#include "cards_common.hpp"
+
+#include "durak_game.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+    Opening book: best first attack card for fresh six-card hand and trump suit.
+
+    Position key is canonical up to suit symmetry: the trump suit goes to slot 0,
+    other suits are sorted by their value patterns (descending) into slots 1..3.
+    Every slot keeps 9 bits for values Six..Ace of CardDeck36, so the key is a
+    36-bit mask of canonical card indices (slot * 9 + value - Six).
+
+    Book file: OpeningBookHeader followed by open addressing hash table of
+    uint64_t slots, slot = (key << 8) | canonical index of best card, 0 - empty.
+*/
+
+// opening book position
+namespace durak_game {
+namespace opening_book {
+constexpr size_t suit_values_cnt = 9;
+constexpr size_t opening_hand_size = hands_start_amount;
+
+// canonical suit slot -> real suit and back
+struct SuitMapping {
+    std::array<cards_common::CardsSuit, 4> slot_suit;
+};
+
+inline uint64_t suit_pattern(cards_common::CardMask hand, cards_common::CardsSuit suit) {
+    const size_t shift =
+        ((size_t)suit - (size_t)cards_common::CardsSuit::Spades) * 13
+        + ((size_t)cards_common::CardsValue::Six - (size_t)cards_common::CardsValue::Deuce);
+    return (hand >> shift) & ((uint64_t(1) << suit_values_cnt) - 1);
+}
+
+inline uint64_t canonical_key(cards_common::CardMask hand, cards_common::CardsSuit trump_suit, SuitMapping* mapping = nullptr) {
+    std::array<std::pair<uint64_t, cards_common::CardsSuit>, 3> others;
+    size_t others_cnt = 0;
+    for (int suit = (int)cards_common::CardsSuit::Spades; suit <= (int)cards_common::CardsSuit::Hearts; ++suit) {
+        if ((cards_common::CardsSuit)suit == trump_suit)
+            continue;
+        others[others_cnt++] = { suit_pattern(hand, (cards_common::CardsSuit)suit), (cards_common::CardsSuit)suit };
+    }
+    std::sort(others.begin(), others.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    uint64_t key = suit_pattern(hand, trump_suit);
+    for (size_t slot = 0; slot < others.size(); slot++)
+        key |= others[slot].first << ((slot + 1) * suit_values_cnt);
+
+    if (nullptr != mapping) {
+        mapping->slot_suit[0] = trump_suit;
+        for (size_t slot = 0; slot < others.size(); slot++)
+            mapping->slot_suit[slot + 1] = others[slot].second;
+    }
+    return key;
+}
+
+inline cards_common::Card canonical_card(size_t canonical_idx, const SuitMapping& mapping) {
+    return cards_common::Card(
+        mapping.slot_suit[canonical_idx / suit_values_cnt],
+        (cards_common::CardsValue)((size_t)cards_common::CardsValue::Six + canonical_idx % suit_values_cnt));
+}
+
+inline size_t canonical_card_index(const cards_common::Card& card, const SuitMapping& mapping) {
+    size_t slot = 0;
+    while (mapping.slot_suit[slot] != card.suit_)
+        slot++;
+    return slot * suit_values_cnt + ((size_t)card.value_ - (size_t)cards_common::CardsValue::Six);
+}
+
+inline uint64_t hash_key(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+} // namespace opening_book
+} // namespace durak_game
+
+// OpeningBook
+namespace durak_game {
+namespace opening_book {
+struct OpeningBookHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t hands_cnt;
+    uint64_t capacity;
+    uint64_t entries_cnt;
+};
+
+constexpr char book_magic[8] = { 'D', 'U', 'R', 'A', 'K', 'O', 'B', 'K' };
+constexpr uint32_t book_version = 1;
+
+// read-only memory mapping of whole file
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#if defined(_WIN32)
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (INVALID_HANDLE_VALUE == file_)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size) || 0 == size.QuadPart) {
+            close();
+            return false;
+        }
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (nullptr == mapping_) {
+            close();
+            return false;
+        }
+        data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        size_ = (size_t)size.QuadPart;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (0 != fstat(fd, &st) || 0 == st.st_size) {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (MAP_FAILED == data)
+            return false;
+        data_ = data;
+        size_ = (size_t)st.st_size;
+#endif
+        if (nullptr == data_) {
+            close();
+            return false;
+        }
+        return true;
+    }
+    void close() {
+#if defined(_WIN32)
+        if (nullptr != data_)
+            UnmapViewOfFile(data_);
+        if (nullptr != mapping_)
+            CloseHandle(mapping_);
+        if (INVALID_HANDLE_VALUE != file_)
+            CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (nullptr != data_)
+            munmap(data_, size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const void* data() const { return data_; }
+    size_t size() const { return size_; }
+private:
+#if defined(_WIN32)
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+class OpeningBook
+{
+public:
+    OpeningBook()
+        : header_(nullptr)
+        , slots_(nullptr) {}
+
+    bool load(const std::string& path) {
+        header_ = nullptr;
+        slots_ = nullptr;
+        if (!file_.open(path))
+            return false;
+        if (file_.size() < sizeof(OpeningBookHeader))
+            return false;
+        const OpeningBookHeader* header = static_cast<const OpeningBookHeader*>(file_.data());
+        if (0 != std::memcmp(header->magic, book_magic, sizeof(book_magic)) ||
+            book_version != header->version ||
+            0 == header->capacity ||
+            0 != (header->capacity & (header->capacity - 1)) ||
+            header->capacity <= header->entries_cnt ||
+            file_.size() < sizeof(OpeningBookHeader) + header->capacity * sizeof(uint64_t))
+            return false;
+        header_ = header;
+        slots_ = reinterpret_cast<const uint64_t*>(header + 1);
+        return true;
+    }
+    bool empty() const {
+        return nullptr == header_;
+    }
+    size_t get_hands_cnt() const {
+        return empty() ? 0 : header_->hands_cnt;
+    }
+    size_t size() const {
+        return empty() ? 0 : (size_t)header_->entries_cnt;
+    }
+
+    // canonical index of the best card, or -1; probes at most capacity slots of a corrupt table
+    int find(uint64_t key) const {
+        if (empty())
+            return -1;
+        const uint64_t mask = header_->capacity - 1;
+        uint64_t pos = hash_key(key) & mask;
+        for (uint64_t probe = 0; probe < header_->capacity; probe++, pos = (pos + 1) & mask) {
+            const uint64_t slot = slots_[pos];
+            if (0 == slot)
+                return -1;
+            if ((slot >> 8) == key)
+                return (int)(slot & 0xFF);
+        }
+        return -1;
+    }
+
+    // book shared by all decisions of the process, loaded once per path
+    static std::shared_ptr<const OpeningBook> shared(const std::string& path) {
+        static std::mutex books_mutex;
+        static std::map<std::string, std::shared_ptr<const OpeningBook>> books;
+
+        std::lock_guard<std::mutex> lock(books_mutex);
+        std::shared_ptr<const OpeningBook>& book = books[path];
+        if (!book) {
+            std::shared_ptr<OpeningBook> loaded = std::make_shared<OpeningBook>();
+            if (!loaded->load(path))
+                std::cerr << "Unable to load opening book: " << path << std::endl;
+            book = loaded;
+        }
+        return book;
+    }
+private:
+    MappedFile file_;
+    const OpeningBookHeader* header_;
+    const uint64_t* slots_;
+};
+
+class OpeningBookWriter
+{
+public:
+    void add(uint64_t key, size_t canonical_card_idx) {
+        entries_[key] = canonical_card_idx;
+    }
+    size_t size() const {
+        return entries_.size();
+    }
+    bool write(const std::string& path, size_t hands_cnt) const {
+        uint64_t capacity = 1;
+        while (capacity < 2 * entries_.size())
+            capacity <<= 1;
+
+        std::vector<uint64_t> slots((size_t)capacity, 0);
+        for (const auto& entry : entries_) {
+            uint64_t pos = hash_key(entry.first) & (capacity - 1);
+            while (0 != slots[(size_t)pos])
+                pos = (pos + 1) & (capacity - 1);
+            slots[(size_t)pos] = (entry.first << 8) | (uint64_t)entry.second;
+        }
+
+        OpeningBookHeader header = {};
+        std::memcpy(header.magic, book_magic, sizeof(book_magic));
+        header.version = book_version;
+        header.hands_cnt = (uint32_t)hands_cnt;
+        header.capacity = capacity;
+        header.entries_cnt = entries_.size();
+
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint64_t));
+        return ofs.good();
+    }
+private:
+    std::map<uint64_t, size_t> entries_;
+};
+} // namespace opening_book
+} // namespace durak_game
+
+// GameHandDecisionOpeningBook
+namespace durak_game {
+template <size_t HandsCnt>
+bool is_opening_attack(const GameStateConstPtr<HandsCnt>& state) {
+    return Stage::AttackStage == state->get_current_stage()
+        && 0 == state->get_table_size()
+        && 0 == state->get_garbage_size()
+        && opening_book::opening_hand_size == state->get_active_hand().size()
+        && cards_common::get_deck_size(cards_common::CardDeckType::CardDeck36)
+            - HandsCnt * hands_start_amount == state->get_deck_size();
+}
+
+// first attack from the opening book, Inner decision for everything else
+template <size_t HandsCnt, class Inner>
+class GameHandDecisionOpeningBook
+    : public GameHandDecision<HandsCnt>
+{
+public:
+    static std::string decision_name() {
+        return "OpeningBook(" + Inner::decision_name() + ")";
+    };
+public:
+    explicit GameHandDecisionOpeningBook(std::shared_ptr<const opening_book::OpeningBook> book)
+        : book_(std::move(book))
+    {}
+    explicit GameHandDecisionOpeningBook(const std::string& book_path)
+        : book_(opening_book::OpeningBook::shared(book_path))
+    {}
+
+    void set_to_game(size_t hand_idx, Game<HandsCnt>& owner_game) override {
+        inner_.set_to_game(hand_idx, owner_game);
+    }
+    void game_reset(const GameStateConstPtr<HandsCnt>& state) override {
+        inner_.game_reset(state);
+    }
+    AttackAction attack_step(const GameStateConstPtr<HandsCnt>& state) override {
+        AttackAction action;
+        if (find_opening_attack(state, action))
+            return action;
+        return inner_.attack_step(state);
+    }
+    DefendAction defend_step(const GameStateConstPtr<HandsCnt>& state) override {
+        return inner_.defend_step(state);
+    }
+    AttackAction attack_step_with_budget(const GameStateConstPtr<HandsCnt>& state, const DecisionBudget& budget) override {
+        AttackAction action;
+        if (find_opening_attack(state, action))
+            return action;
+        return inner_.attack_step_with_budget(state, budget);
+    }
+    DefendAction defend_step_with_budget(const GameStateConstPtr<HandsCnt>& state, const DecisionBudget& budget) override {
+        return inner_.defend_step_with_budget(state, budget);
+    }
+private:
+    bool find_opening_attack(const GameStateConstPtr<HandsCnt>& state, AttackAction& action) const {
+        if (HandsCnt != book_->get_hands_cnt() || !is_opening_attack(state))
+            return false;
+        opening_book::SuitMapping mapping;
+        const cards_common::CardMask hand = state->get_active_hand_mask();
+        const int card_idx = book_->find(opening_book::canonical_key(hand, state->get_trump_suit(), &mapping));
+        if (card_idx < 0)
+            return false;
+        const cards_common::Card card = opening_book::canonical_card((size_t)card_idx, mapping);
+        if (0 == (hand & cards_common::card_mask(card)))
+            return false;
+        action = { AttackActionType::Attack, card };
+        return true;
+    }
+private:
+    std::shared_ptr<const opening_book::OpeningBook> book_;
+    Inner inner_;
+};
+} // namespace durak_game
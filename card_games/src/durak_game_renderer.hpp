@@ -0,0 +1,119 @@
+#pragma once
+#include "cards_renderer.hpp"
+#include "durak_game.hpp"
+
+#include <algorithm>
+#include <string>
+
+// GameRenderer
+namespace durak_game {
+template <typename RenderState>
+class GameRenderer
+{
+public:
+    GameRenderer(const std::string &background_img_path,
+                 const std::string &cards_deck_img_path,
+                 const std::string &cards_back_img_path,
+                 const cv::Size &table_size)
+        : renderer_(background_img_path, cards_deck_img_path, cards_back_img_path, table_size)
+    {
+    }
+    virtual ~GameRenderer() {}
+public:
+    const cv::Mat &render(const RenderState &state)
+    {
+        renderer_.reset_cards();
+        if (!state.is_deck_empty())
+            draw_deck(state);
+
+        draw_hands(state);
+        draw_table(state);
+        return renderer_.render();
+    }
+    // области, измененные последним render()
+    const std::vector<cv::Rect> &get_dirty_rects() const
+    {
+        return renderer_.get_dirty_rects();
+    }
+    // следующий render() перерисует весь стол
+    void invalidate()
+    {
+        renderer_.invalidate();
+    }
+private:
+    cards_renderer::TableRenderer renderer_;
+
+    void draw_deck(const RenderState &state)
+    {
+        const cv::Size &table_sz = renderer_.get_table_size();
+        const cv::Size &card_sz = renderer_.get_card_size();
+        cv::Point temp;
+        temp.x = (table_sz.width / 5 - card_sz.height) / 2;
+        temp.y = table_sz.height / 2 - card_sz.width / 2;
+        renderer_.add_card(temp,
+            state.get_trump_card(),
+            cards_renderer::rc90cw);
+
+        if (1 < state.get_deck_size())
+        {
+            temp.y = table_sz.height / 2 - card_sz.height / 2;
+            renderer_.add_card(temp,
+                cards_common::Card(cards_common::CardsSuit::SuitNone, cards_common::CardsValue::ValueNone));
+        }
+    }
+    void draw_hand(const cv::Rect &roi, const cards_common::CardSet &hand)
+    {
+        const int cards_cnt = (int)hand.size();
+
+        const cv::Size &card_sz = renderer_.get_card_size();
+
+        const int width_sm = roi.width - 2 * card_sz.width / 3;
+        const int shift = (cards_cnt <= 1) 
+                            ? 0 
+                            : (width_sm - card_sz.width) / (std::max(6, cards_cnt) - 1);
+
+        cv::Point pt = roi.tl() + cv::Point(card_sz.width / 3, card_sz.height / 6);
+        for (auto item : hand)
+        {
+            renderer_.add_card(pt, item);
+            pt.x += shift;
+        }
+    }
+    void draw_hands(const RenderState &state)
+    {
+        const cv::Size &table_sz = renderer_.get_table_size();
+        cv::Rect rc(table_sz.width / 5, 0, 4 * table_sz.width / 5, table_sz.height / 3);
+        draw_hand(rc, state.get_hand(0));
+        rc.y = 2 * table_sz.height / 3;
+        draw_hand(rc, state.get_hand(1));
+    }
+    void draw_table (const RenderState &state)
+    {
+        const cv::Size &table_sz = renderer_.get_table_size();
+        const cv::Size &card_sz = renderer_.get_card_size();
+            
+        cv::Point tl(table_sz.width / 5, 
+                        table_sz.height / 3 + (table_sz.height / 3 - 6 * card_sz.height / 5));
+
+        const cards_common::CardList &table = state.get_table();
+        const int tbl_pair_cnt = ((int)table.size() + 1) / 2;
+        const int width_sm = (4 * table_sz.width / 5) - 2 * card_sz.width / 3;
+        const int shift = (tbl_pair_cnt <= 1)
+            ? 0
+            : (width_sm - card_sz.width) / (std::max(6, tbl_pair_cnt) - 1);
+
+        cv::Point pt[2] = { tl, tl + cv::Point(card_sz.width / 2, card_sz.height / 5) };
+        int delta = 0;
+        for (auto item : table)
+        {
+            renderer_.add_card(pt[delta], item);
+            delta = (delta + 1) % 2;
+            if (0 == delta)
+            {
+                pt[0].x += shift;
+                pt[1].x += shift;
+            }
+        }
+    }
+};
+};
@@ -0,0 +1,327 @@
+#pragma once
+#include "durak_game.hpp"
+#include "durak_game_renderer.hpp"
+#include "durak_game_decision_registry.hpp"
+#include "durak_game_thread_pool.hpp"
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/videoio.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// GameReplay
+namespace durak_game {
+/*
+    Recorded game: decisions of hands 0 and 1 by DecisionRegistry name and the
+    arguments of Game::init. Decisions draw random numbers from per-hand
+    streams of the game seed, so replaying the record repeats the game.
+*/
+struct GameReplay {
+    std::string first_decision_name;    // hand 0
+    std::string second_decision_name;   // hand 1
+    unsigned int seed = 0;
+    int start_hand_idx = -1;
+    bool antithetic_deal = false;
+};
+
+/*
+    Text list of records, one game per line, '#' starts a comment:
+        <hand 0 decision> <hand 1 decision> <seed> [<start hand> [antithetic]]
+*/
+inline std::vector<GameReplay> load_game_replays(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Unable to read games: " + path);
+    std::vector<GameReplay> replays;
+    std::string line;
+    for (size_t line_idx = 1; std::getline(file, line); line_idx++) {
+        if (line.empty() || '#' == line[0])
+            continue;
+        const std::string line_name = path + ":" + std::to_string(line_idx);
+        std::istringstream stream(line);
+        GameReplay replay;
+        if (!(stream >> replay.first_decision_name >> replay.second_decision_name >> replay.seed))
+            throw std::runtime_error(line_name + ": invalid game record");
+        std::string token;
+        if (stream >> token) {
+            std::istringstream start_hand(token);
+            if (!(start_hand >> replay.start_hand_idx) || !start_hand.eof())
+                throw std::runtime_error(line_name + ": invalid game record");
+            if (stream >> token) {
+                if ("antithetic" != token)
+                    throw std::runtime_error(line_name + ": unknown deal " + token);
+                replay.antithetic_deal = true;
+            }
+            if (stream >> token)
+                throw std::runtime_error(line_name + ": invalid game record");
+        }
+        replays.push_back(replay);
+    }
+    return replays;
+}
+} // namespace durak_game
+
+// ReplayRenderer
+namespace durak_game {
+/*
+    Headless renderer of recorded games to a frame stream.
+
+    Games are replayed on a WorkStealingPool, every worker has own Game and
+    GameRenderer (so own TableRenderer) and renders a frame on every stage
+    change, as GameVisualizer does. Workers take games in order and a writer
+    thread passes the frames of every game to the sink as soon as all earlier
+    games are written. At most games_in_flight games are rendered or wait for
+    the writer at a time, so the memory of frames does not grow with the
+    count of threads.
+*/
+class ReplayRenderer
+{
+public:
+    using FrameSink = std::function<void(const cv::Mat& /*frame*/)>;
+
+    struct Params {
+        std::string background_img_path;
+        std::string cards_deck_img_path = "../res/cards_deck_sm.png";
+        std::string cards_back_img_path = "../res/back_sm.png";
+        cv::Size table_size = cv::Size(1000, 600);
+        size_t end_frames_cnt = 1; // copies of the final table, pause between games
+        size_t games_in_flight = 8; // games with frames in memory
+    };
+public:
+    // threads_cnt == 0 - общий пул на все ядра
+    ReplayRenderer(const DecisionRegistry& registry, const Params& params, size_t threads_cnt = 0)
+        : registry_(registry)
+        , params_(params)
+        , own_pool_(0 == threads_cnt ? nullptr : new WorkStealingPool(threads_cnt))
+        , pool_(own_pool_ ? *own_pool_ : WorkStealingPool::shared())
+    {
+        for (size_t i = 0; i < pool_.size(); i++)
+            workers_.emplace_back(new Worker(params_));
+    }
+
+    // returns count of frames passed to sink
+    size_t render(const std::vector<GameReplay>& replays, const FrameSink& sink) {
+        for (const auto& replay : replays) {
+            registry_.factory(replay.first_decision_name);
+            registry_.factory(replay.second_decision_name);
+        }
+
+        OrderedGameFrames games(replays.size(), params_.games_in_flight);
+        std::thread writer([&games, &sink]() { games.write(sink); });
+        // every worker takes games until none is left, a game is never claimed before an earlier one
+        pool_.run(pool_.size(), 1, [&](size_t worker_idx, size_t /*begin*/, size_t /*end*/) {
+            for (size_t game_idx = 0; games.claim(game_idx);) {
+                try {
+                    games.finish(game_idx, workers_[worker_idx]->render(replays[game_idx], registry_));
+                }
+                catch (...) {
+                    games.fail(std::current_exception());
+                }
+            }
+        });
+        writer.join();
+        games.rethrow_error();
+        return games.get_frames_cnt();
+    }
+private:
+    /*
+        Frames of rendered games on their way to the sink. Games are claimed in
+        order and written in order; a game is in flight from claim() until its
+        frames are written, claim() waits while games_in_flight games are.
+    */
+    class OrderedGameFrames
+    {
+    public:
+        OrderedGameFrames(size_t games_cnt, size_t games_in_flight)
+            : games_cnt_(games_cnt)
+            , slots_(std::max<size_t>(1, games_in_flight))
+            , ready_(slots_.size(), false)
+            , next_claim_(0)
+            , next_write_(0)
+            , frames_cnt_(0) {}
+
+        // false - no games left or rendering failed
+        bool claim(size_t& game_idx) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this]() {
+                return error_ || games_cnt_ <= next_claim_ || next_claim_ < next_write_ + slots_.size();
+            });
+            if (error_ || games_cnt_ <= next_claim_)
+                return false;
+            game_idx = next_claim_++;
+            return true;
+        }
+        void finish(size_t game_idx, std::vector<cv::Mat> frames) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                slots_[game_idx % slots_.size()] = std::move(frames);
+                ready_[game_idx % slots_.size()] = true;
+            }
+            changed_.notify_all();
+        }
+        void fail(std::exception_ptr error) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_)
+                    error_ = error;
+            }
+            changed_.notify_all();
+        }
+
+        // passes frames of all games to sink in game order, stops at the first error of rendering or sink
+        void write(const FrameSink& sink) {
+            for (;;) {
+                std::vector<cv::Mat> frames;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    changed_.wait(lock, [this]() {
+                        return error_ || games_cnt_ <= next_write_ || ready_[next_write_ % slots_.size()];
+                    });
+                    if (error_ || games_cnt_ <= next_write_)
+                        break;
+                    frames.swap(slots_[next_write_ % slots_.size()]);
+                    ready_[next_write_ % slots_.size()] = false;
+                }
+                try {
+                    for (const auto& frame : frames)
+                        sink(frame);
+                }
+                catch (...) {
+                    fail(std::current_exception());
+                    break;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    next_write_++;
+                    frames_cnt_ += frames.size();
+                }
+                changed_.notify_all();
+            }
+        }
+        void rethrow_error() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error_)
+                std::rethrow_exception(error_);
+        }
+        size_t get_frames_cnt() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return frames_cnt_;
+        }
+    private:
+        const size_t games_cnt_;
+        std::vector<std::vector<cv::Mat>> slots_; // frames of game i in slot i % games_in_flight
+        std::vector<bool> ready_;
+        size_t next_claim_;
+        size_t next_write_;
+        size_t frames_cnt_;
+        std::exception_ptr error_;
+        mutable std::mutex mutex_;
+        std::condition_variable changed_;
+    };
+
+    class Worker
+    {
+        class FrameEvent
+            : public GameChangingStageEvent
+        {
+        public:
+            explicit FrameEvent(Worker& owner)
+                : owner_(owner) {}
+            void stage_changing(Stage /*old_stage*/, Stage new_stage) override {
+                if (Stage::NoneStage != new_stage)
+                    owner_.add_frame();
+            }
+        private:
+            Worker& owner_;
+        };
+    public:
+        explicit Worker(const Params& params)
+            : renderer_(params.background_img_path, params.cards_deck_img_path, params.cards_back_img_path, params.table_size)
+            , end_frames_cnt_(params.end_frames_cnt)
+            , frames_(nullptr)
+        {
+            game_.add_stage_changing_event(std::unique_ptr<GameChangingStageEvent>(new FrameEvent(*this)));
+        }
+
+        std::vector<cv::Mat> render(const GameReplay& replay, const DecisionRegistry& registry) {
+            std::vector<cv::Mat> frames;
+            game_.set_hand_decision(0, registry.factory(replay.first_decision_name)());
+            game_.set_hand_decision(1, registry.factory(replay.second_decision_name)());
+            frames_ = &frames;
+            game_.init(replay.start_hand_idx, replay.seed, replay.antithetic_deal);
+            game_.run();
+            for (size_t i = 0; i < end_frames_cnt_; i++)
+                add_frame();
+            frames_ = nullptr;
+            return frames;
+        }
+    private:
+        Game<2> game_;
+        GameRenderer<GameRenderState<2>> renderer_;
+        size_t end_frames_cnt_;
+        std::vector<cv::Mat>* frames_;
+
+        void add_frame() {
+            if (nullptr != frames_)
+                frames_->push_back(renderer_.render(GameRenderState<2>(game_)).clone());
+        }
+    };
+private:
+    const DecisionRegistry& registry_;
+    Params params_;
+    std::unique_ptr<WorkStealingPool> own_pool_;
+    WorkStealingPool& pool_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+// frames as <directory>/frame_000000.png, ...
+class ImageSequenceSink
+{
+public:
+    ImageSequenceSink(const std::string& directory, const std::string& extension = "png")
+        : directory_(directory)
+        , extension_(extension)
+        , frame_idx_(0) {}
+
+    void operator()(const cv::Mat& frame) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06zu.", frame_idx_++);
+        const std::string path = directory_ + "/" + name + extension_;
+        if (!cv::imwrite(path, frame))
+            throw std::runtime_error("Unable to write frame: " + path);
+    }
+private:
+    std::string directory_;
+    std::string extension_;
+    size_t frame_idx_;
+};
+
+class VideoSink
+{
+public:
+    VideoSink(const std::string& path, double fps, const cv::Size& frame_size, int fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G'))
+        : writer_(std::make_shared<cv::VideoWriter>())
+    {
+        if (!writer_->open(path, fourcc, fps, frame_size, true))
+            throw std::runtime_error("Unable to open video: " + path);
+    }
+
+    void operator()(const cv::Mat& frame) {
+        writer_->write(frame);
+    }
+private:
+    std::shared_ptr<cv::VideoWriter> writer_; // FrameSink is copyable
+};
+} // namespace durak_game
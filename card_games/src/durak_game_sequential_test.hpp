@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+// SequentialTest
+namespace durak_game {
+struct SequentialTestParams {
+    double delta = 0.02;        // interesting difference of the first decision score from 0.5
+    double alpha = 0.05;        // false "better" rate for every side
+    double beta = 0.05;         // false "draw" rate
+    size_t min_seeds_cnt = 200; // no decision before that many seeds
+    size_t batch_seeds_cnt = 200;
+};
+
+enum class SequentialTestResult {
+    Continue,
+    FirstBetter,
+    SecondBetter,
+    Draw
+};
+
+inline std::string to_string(SequentialTestResult result) {
+    switch (result) {
+    case SequentialTestResult::FirstBetter:
+        return "first decision better";
+    case SequentialTestResult::SecondBetter:
+        return "second decision better";
+    case SequentialTestResult::Draw:
+        return "draw (difference less than delta)";
+    default:
+        return "not decided";
+    }
+}
+
+/*
+    Two one-sided SPRT on the paired score of the first decision.
+
+    Sample is one seed: score of the first decision in all games of the seed
+    (both decision orders and both start hands, 4 games per deal, draw - half
+    point) minus 0.5.
+    Normal approximation with sample variance:
+        LLR(mu0, mu1) = n * (mu1 - mu0) * (2 * mean - mu0 - mu1) / (2 * variance)
+    "up" test is mu = 0 vs mu = +delta, "down" test is mu = 0 vs mu = -delta.
+    Decision is "better" when one of the tests accepts its H1, and "draw" when
+    both tests accept H0.
+*/
+class SequentialTest
+{
+public:
+    SequentialTest()
+        : samples_cnt_(0)
+        , sum_(0.)
+        , sq_sum_(0.) {}
+    SequentialTest(size_t samples_cnt, double sum, double sq_sum)
+        : samples_cnt_(samples_cnt)
+        , sum_(sum)
+        , sq_sum_(sq_sum) {}
+
+    void add(double sample) {
+        samples_cnt_++;
+        sum_ += sample;
+        sq_sum_ += sample * sample;
+    }
+    void merge(const SequentialTest& other) {
+        samples_cnt_ += other.samples_cnt_;
+        sum_ += other.sum_;
+        sq_sum_ += other.sq_sum_;
+    }
+    void clear() {
+        samples_cnt_ = 0;
+        sum_ = sq_sum_ = 0.;
+    }
+
+    size_t samples_cnt() const {
+        return samples_cnt_;
+    }
+    double sum() const {
+        return sum_;
+    }
+    double sq_sum() const {
+        return sq_sum_;
+    }
+    double mean() const {
+        return (0 == samples_cnt_) ? 0. : sum_ / (double)samples_cnt_;
+    }
+    double variance() const {
+        if (samples_cnt_ < 2)
+            return 0.;
+        const double n = (double)samples_cnt_;
+        return std::max(0., (sq_sum_ - sum_ * sum_ / n) / (n - 1.));
+    }
+
+    double llr(double mu0, double mu1) const {
+        // all seeds with the same score give zero variance, the smallest nonzero score step is 1/8
+        const double variance = std::max(this->variance(), 1. / 256.);
+        return (double)samples_cnt_ * (mu1 - mu0) * (2. * mean() - mu0 - mu1) / (2. * variance);
+    }
+    double upper_bound(const SequentialTestParams& params) const {
+        return std::log((1. - params.beta) / params.alpha);
+    }
+    double lower_bound(const SequentialTestParams& params) const {
+        return std::log(params.beta / (1. - params.alpha));
+    }
+
+    SequentialTestResult result(const SequentialTestParams& params) const {
+        if (samples_cnt_ < params.min_seeds_cnt)
+            return SequentialTestResult::Continue;
+        const double llr_up = llr(0., params.delta);
+        const double llr_down = llr(0., -params.delta);
+        if (llr_up >= upper_bound(params))
+            return SequentialTestResult::FirstBetter;
+        if (llr_down >= upper_bound(params))
+            return SequentialTestResult::SecondBetter;
+        if (llr_up <= lower_bound(params) && llr_down <= lower_bound(params))
+            return SequentialTestResult::Draw;
+        return SequentialTestResult::Continue;
+    }
+private:
+    size_t samples_cnt_;
+    double sum_;
+    double sq_sum_;
+};
+} // namespace durak_game
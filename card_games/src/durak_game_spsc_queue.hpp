@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// SpscQueue
+namespace durak_game {
+/*
+    Bounded lock-free queue for one producer and one consumer thread.
+    Slots are allocated in the constructor, try_push and try_pop only copy
+    values, try_push fails instead of waiting when the queue is full.
+*/
+template <class T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : head_(0)
+        , tail_(0)
+    {
+        size_t slots_cnt = 2;
+        while (slots_cnt < capacity)
+            slots_cnt <<= 1;
+        slots_.resize(slots_cnt);
+        mask_ = slots_cnt - 1;
+    }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer thread
+    bool try_push(const T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_)
+            return false;
+        slots_[head & mask_] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    // consumer thread
+    bool try_pop(T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+        value = slots_[tail & mask_];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const {
+        return slots_.size();
+    }
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_; // written by the producer
+    alignas(64) std::atomic<size_t> tail_; // written by the consumer
+};
+} // namespace durak_game
@@ -1,10 +1,18 @@
 #pragma once
 #include "durak_game.hpp"
+#include "durak_game_live_sampler.hpp"
+#include "durak_game_sequential_test.hpp"
+#include "durak_game_thread_pool.hpp"
 
 #include <iostream>
 #include <iomanip>
-#include <thread>
-#include <future>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 // GameStatistic
 namespace durak_game {
@@ -15,6 +23,20 @@ struct GameStatistic {
     size_t games_count() const {
         return first_decision_win + second_decision_win + draw;
     }
+    void merge(const GameStatistic& other) {
+        first_decision_win += other.first_decision_win;
+        second_decision_win += other.second_decision_win;
+        draw += other.draw;
+    }
+    // loser_hand_idx - результат Game::run, first_decision_hand_idx - рука первого решения
+    void add_game_result(int loser_hand_idx, size_t first_decision_hand_idx) {
+        if (-1 == loser_hand_idx)
+            draw++;
+        else if ((size_t)loser_hand_idx == first_decision_hand_idx)
+            second_decision_win++;
+        else
+            first_decision_win++;
+    }
 };
 struct FullStatistic {
     std::string first_decision_name;
@@ -23,6 +45,24 @@ struct FullStatistic {
     GameStatistic first_decision_start;
     GameStatistic second_decision_start;
 
+    DecisionLatency first_decision_latency;
+    DecisionLatency second_decision_latency;
+
+    // обе игры пары вместе, только с DURAK_GAME_TELEMETRY
+    GameTelemetry telemetry;
+
+    // только для run_adaptive: сколько seed было можно сыграть и чем закончился тест
+    size_t seeds_budget = 0;
+    SequentialTestResult sequential_result = SequentialTestResult::Continue;
+    double sequential_llr_up = 0.;
+    double sequential_llr_down = 0.;
+
+    // очки первого решения по seed минус 0.5, для стандартной ошибки и последовательного теста
+    SequentialTest seed_scores;
+
+    static constexpr size_t games_per_seed = 4; // на одну раздачу
+    size_t deals_per_seed = 1;                  // 2 - с антитетической раздачей
+
     size_t first_decision_win() const {
         return first_decision_start.first_decision_win + second_decision_start.first_decision_win;
     }
@@ -43,6 +83,33 @@ struct FullStatistic {
         return first_decision_start.games_count() + second_decision_start.games_count();
     }
 
+    void merge(const FullStatistic& other) {
+        first_decision_start.merge(other.first_decision_start);
+        second_decision_start.merge(other.second_decision_start);
+        first_decision_latency.merge(other.first_decision_latency);
+        second_decision_latency.merge(other.second_decision_latency);
+        telemetry.merge(other.telemetry);
+        seed_scores.merge(other.seed_scores);
+    }
+
+    // доля очков первого решения (ничья - пол-очка)
+    double first_decision_score() const {
+        return (0 == games_count()) ? 0. : ((double)first_decision_win() + 0.5 * (double)draw()) / (double)games_count();
+    }
+    // стандартная ошибка first_decision_score по seed, учитывающая связь игр одного seed
+    double first_decision_score_error() const {
+        return (seed_scores.samples_cnt() < 2) ? 0. : std::sqrt(seed_scores.variance() / (double)seed_scores.samples_cnt());
+    }
+    // стандартная ошибка, если бы все игры были независимыми
+    double first_decision_score_naive_error() const {
+        if (0 == games_count())
+            return 0.;
+        const double n = (double)games_count();
+        const double score = first_decision_score();
+        const double sq_score = ((double)first_decision_win() + 0.25 * (double)draw()) / n;
+        return std::sqrt(std::max(0., sq_score - score * score) / n);
+    }
+
     friend std::ostream& operator<< (std::ostream& stream, const FullStatistic& statistic) {
         stream
             << statistic.first_decision_name
@@ -154,103 +221,327 @@ struct FullStatistic {
                 << "%)"
                 << std::endl;
         }
+        /////////////////////////////////////////////////////////////
+        if (1 < statistic.seed_scores.samples_cnt()) {
+            const double error = statistic.first_decision_score_error();
+            const double naive_error = statistic.first_decision_score_naive_error();
+            stream
+                << "First decision score:     "
+                << std::setw(7) << 100. * statistic.first_decision_score()
+                << "% +- " << 100. * error << "% (standard error, "
+                << statistic.seed_scores.samples_cnt() << " seeds"
+                << (1 < statistic.deals_per_seed ? ", antithetic deals" : "")
+                << ")" << std::endl;
+            stream
+                << "  independent games error: "
+                << std::setw(6) << 100. * naive_error << "%";
+            if (0. < error)
+                stream << ", variance reduction: x" << naive_error * naive_error / (error * error);
+            stream << std::endl;
+        }
+        /////////////////////////////////////////////////////////////
+        if (0 < statistic.seeds_budget) {
+            const size_t games_budget = games_per_seed * statistic.deals_per_seed * statistic.seeds_budget;
+            stream
+                << "Sequential test: " << to_string(statistic.sequential_result)
+                << " (LLR up: " << statistic.sequential_llr_up
+                << ", LLR down: " << statistic.sequential_llr_down << ")"
+                << std::endl;
+            stream
+                << "  games played:           "
+                << std::setw(7) << statistic.games_count()
+                << " of " << games_budget
+                << std::endl;
+            stream
+                << "  games saved:            "
+                << std::setw(7) << games_budget - statistic.games_count()
+                << " ("
+                << 100. * (games_budget - statistic.games_count()) / games_budget
+                << "%)"
+                << std::endl;
+        }
+        /////////////////////////////////////////////////////////////
+        if (0 < statistic.first_decision_latency.count() || 0 < statistic.second_decision_latency.count()) {
+            stream
+                << "Decision latency (ns), first decision: " << std::endl
+                << statistic.first_decision_latency;
+            stream
+                << "Decision latency (ns), second decision: " << std::endl
+                << statistic.second_decision_latency;
+        }
+        /////////////////////////////////////////////////////////////
+        if (!statistic.telemetry.empty()) {
+            stream
+                << "Game telemetry: " << std::endl
+                << statistic.telemetry;
+        }
         return stream;
     }
 };
 
-int run_game(Game<2>* pgame, int start_hand_idx, unsigned int seed) {
-    pgame->init(start_hand_idx, seed);
+// результаты и телеметрия пары в текстовом формате Prometheus для дашбордов
+inline void write_metrics(std::ostream& stream, const FullStatistic& statistic) {
+    const std::string labels =
+        "first=\"" + statistic.first_decision_name + "\",second=\"" + statistic.second_decision_name + "\"";
+    stream
+        << "durak_game_pair_games_total{" << labels << "} " << statistic.games_count() << "\n"
+        << "durak_game_pair_first_wins_total{" << labels << "} " << statistic.first_decision_win() << "\n"
+        << "durak_game_pair_second_wins_total{" << labels << "} " << statistic.second_decision_win() << "\n"
+        << "durak_game_pair_draws_total{" << labels << "} " << statistic.draw() << "\n"
+        << "durak_game_pair_first_score{" << labels << "} " << statistic.first_decision_score() << "\n"
+        << "durak_game_pair_first_score_error{" << labels << "} " << statistic.first_decision_score_error() << "\n";
+    if (!statistic.telemetry.empty())
+        statistic.telemetry.write_metrics(stream, labels);
+}
+
+int run_game(Game<2>* pgame, int start_hand_idx, unsigned int seed, bool antithetic_deal = false) {
+    pgame->init(start_hand_idx, seed, antithetic_deal);
     return pgame->run();
 }
 
-template <class GameHandDecisionFirst, class GameHandDecisionSecond>
-class GameStatistician
+// seed всех игр теста, test_steps_cnt штук; seed == -1 - от текущего времени
+inline std::vector<unsigned int> make_game_seeds(size_t test_steps_cnt, unsigned int seed) {
+    if (-1 == seed)
+        seed = (unsigned int)time(0);
+    std::mt19937 generator(seed);
+    std::vector<unsigned int> game_seeds(test_steps_cnt);
+    for (auto& game_seed : game_seeds)
+        game_seed = generator();
+    return game_seeds;
+}
+
+// 4 игры на раздачу: оба порядка решений, обе стартовые руки; с antithetic_deals еще 4 игры
+// на антитетической раздаче того же seed
+// в game_first первое решение играет рукой 0, в game_second - рукой 1
+// возвращает очки первого решения за seed минус 0.5 (ничья - пол-очка)
+inline double play_seed(Game<2>& game_first, Game<2>& game_second, unsigned int game_seed, FullStatistic& statistic,
+                        bool antithetic_deals = false) {
+    GameStatistic seed_first_start;
+    GameStatistic seed_second_start;
+
+    for (int deal = 0; deal < (antithetic_deals ? 2 : 1); deal++) {
+        const bool antithetic = (1 == deal);
+        seed_first_start.add_game_result(run_game(&game_first, 0, game_seed, antithetic), 0);
+        seed_second_start.add_game_result(run_game(&game_second, 0, game_seed, antithetic), 1);
+
+        seed_second_start.add_game_result(run_game(&game_first, 1, game_seed, antithetic), 0);
+        seed_first_start.add_game_result(run_game(&game_second, 1, game_seed, antithetic), 1);
+    }
+
+    statistic.first_decision_start.merge(seed_first_start);
+    statistic.second_decision_start.merge(seed_second_start);
+
+    const double first_score =
+        (double)(seed_first_start.first_decision_win + seed_second_start.first_decision_win)
+        + 0.5 * (double)(seed_first_start.draw + seed_second_start.draw);
+    const double games_cnt = (double)(seed_first_start.games_count() + seed_second_start.games_count());
+    const double sample = first_score / games_cnt - 0.5;
+    statistic.seed_scores.add(sample);
+    return sample;
+}
+
+using GameHandDecisionFactory = std::function<std::unique_ptr<GameHandDecision<2>>()>;
+
+template <class GameHandDecisionType>
+GameHandDecisionFactory make_decision_factory() {
+    return []() { return std::unique_ptr<GameHandDecision<2>>(new GameHandDecisionType()); };
+}
+
+// статистика пары решений, заданных именами и фабриками (например, из реестра решений)
+class DecisionStatistician
 {
+    // игры воркера пула: в game_first первое решение играет рукой 0, в game_second - рукой 1
+    struct WorkerGames {
+        WorkerGames(const GameHandDecisionFactory& first, const GameHandDecisionFactory& second) {
+            game_first.set_hand_decision(0, first());
+            game_first.set_hand_decision(1, second());
+
+            game_second.set_hand_decision(0, second());
+            game_second.set_hand_decision(1, first());
+        }
+        Game<2> game_first;
+        Game<2> game_second;
+        FullStatistic statistic;
+    };
 public:
-    GameStatistician()
+    // threads_cnt == 0 - общий пул на все ядра
+    DecisionStatistician(
+        const std::string& first_decision_name, const GameHandDecisionFactory& first_decision_factory,
+        const std::string& second_decision_name, const GameHandDecisionFactory& second_decision_factory,
+        size_t threads_cnt = 0)
+        : own_pool_(0 == threads_cnt ? nullptr : new WorkStealingPool(threads_cnt))
+        , pool_(own_pool_ ? *own_pool_ : WorkStealingPool::shared())
+        , first_decision_name_(first_decision_name)
+        , second_decision_name_(second_decision_name)
+        , antithetic_deals_(false)
     {
-        game_first_.set_hand_decision(0, std::unique_ptr< GameHandDecision<2> >(new GameHandDecisionFirst()));
-        game_first_.set_hand_decision(1, std::unique_ptr< GameHandDecision<2> >(new GameHandDecisionSecond()));
+        for (size_t i = 0; i < pool_.size(); i++)
+            workers_.emplace_back(new WorkerGames(first_decision_factory, second_decision_factory));
 
-        game_second_.set_hand_decision(0, std::unique_ptr< GameHandDecision<2> >(new GameHandDecisionSecond()));
-        game_second_.set_hand_decision(1, std::unique_ptr< GameHandDecision<2> >(new GameHandDecisionFirst()));
+        set_decision_latency_enabled(true);
     }
+    virtual ~DecisionStatistician() {}
 
-    FullStatistic run(int test_steps_cnt, unsigned int seed = -1) {
-        if (-1 == seed)
-            seed = (unsigned int)time(0);
-        std::mt19937 generator(seed);
-        FullStatistic result_stat;
-        result_stat.first_decision_name = GameHandDecisionFirst::decision_name();
-        result_stat.second_decision_name = GameHandDecisionSecond::decision_name();
-        std::string clear;
-        for (int i = 0; i < test_steps_cnt; i++) {
-            unsigned int game_seed = generator();
-            //std::cout << game_seed << std::endl;
-            {
-                auto future_first = std::async(run_game, &game_first_, 0, game_seed);
-                auto future_second = std::async(run_game, &game_second_, 0, game_seed);
-                switch (future_first.get()) {
-                case 0:
-                    result_stat.first_decision_start.second_decision_win++;
-                    break;
-                case 1:
-                    result_stat.first_decision_start.first_decision_win++;
-                    break;
-                case -1:
-                    result_stat.first_decision_start.draw++;
-                    break;
-                };
-                switch (future_second.get()) {
-                case 0:
-                    result_stat.second_decision_start.first_decision_win++;
-                    break;
-                case 1:
-                    result_stat.second_decision_start.second_decision_win++;
-                    break;
-                case -1:
-                    result_stat.second_decision_start.draw++;
-                    break;
-                };
-            }
-            //std::cout << "---" << std::endl;
-            {
-                auto future_first = std::async(run_game, &game_first_, 1, game_seed);
-                auto future_second = std::async(run_game, &game_second_, 1, game_seed);
-                switch (future_first.get()) {
-                case 0:
-                    result_stat.second_decision_start.second_decision_win++;
-                    break;
-                case 1:
-                    result_stat.second_decision_start.first_decision_win++;
-                    break;
-                case -1:
-                    result_stat.second_decision_start.draw++;
-                    break;
-                };
-                switch (future_second.get()) {
-                case 0:
-                    result_stat.first_decision_start.first_decision_win++;
-                    break;
-                case 1:
-                    result_stat.first_decision_start.second_decision_win++;
-                    break;
-                case -1:
-                    result_stat.first_decision_start.draw++;
-                    break;
-                };
+    void set_decision_latency_enabled(bool enabled) {
+        for (auto& worker : workers_) {
+            worker->game_first.set_decision_latency_enabled(enabled);
+            worker->game_second.set_decision_latency_enabled(enabled);
+        }
+    }
+    const std::string& first_decision_name() const {
+        return first_decision_name_;
+    }
+    const std::string& second_decision_name() const {
+        return second_decision_name_;
+    }
+    // каждый seed играется еще и на антитетической раздаче: 8 игр на seed вместо 4
+    void set_antithetic_deals(bool enabled) {
+        antithetic_deals_ = enabled;
+    }
+    void set_decision_time_limit(std::chrono::nanoseconds time_limit) {
+        for (auto& worker : workers_) {
+            worker->game_first.set_decision_time_limit(time_limit);
+            worker->game_second.set_decision_time_limit(time_limit);
+        }
+    }
+    // живые игры воркеров для монитора: плитки по порядку получают game_first всех воркеров,
+    // затем game_second; привязка остается до конца жизни статистика
+    void attach_sampler(LiveGameSampler& sampler) {
+        for (int order = 0; order < 2; order++) {
+            for (auto& worker : workers_) {
+                Game<2>& game = (0 == order) ? worker->game_first : worker->game_second;
+                std::unique_ptr<GameChangingStageEvent> event = sampler.make_stage_event(game);
+                if (!event)
+                    return;
+                game.add_stage_changing_event(std::move(event));
             }
-            if (i * 50 > (int)clear.size() * test_steps_cnt) {
-                std::cout << "."; std::cout.flush();
-                clear += " ";
+        }
+    }
+
+    // результат не зависит от числа потоков: seed каждой игры определяется seed и ее номером
+    FullStatistic run(int test_steps_cnt, unsigned int seed = -1) {
+        const std::vector<unsigned int> game_seeds = make_game_seeds(test_steps_cnt, seed);
+        start_run(game_seeds.size());
+        play_seeds(game_seeds, 0, game_seeds.size());
+        finish_run();
+        return collect_statistic();
+    }
+    // заданные seed, например очередная порция seed запуска с контрольными точками
+    FullStatistic run_seeds(const std::vector<unsigned int>& game_seeds) {
+        start_run(game_seeds.size());
+        play_seeds(game_seeds, 0, game_seeds.size());
+        finish_run();
+        return collect_statistic();
+    }
+    // только seed [seed_begin, seed_end) из seeds_total seed запуска run(seeds_total, seed), для шардов
+    FullStatistic run_range(size_t seeds_total, unsigned int seed, size_t seed_begin, size_t seed_end) {
+        const std::vector<unsigned int> game_seeds = make_game_seeds(seeds_total, seed);
+        seed_end = std::min(seed_end, game_seeds.size());
+        seed_begin = std::min(seed_begin, seed_end);
+        start_run(seed_end - seed_begin);
+        play_seeds(game_seeds, seed_begin, seed_end);
+        finish_run();
+        return collect_statistic();
+    }
+    // как run, но останавливается, как только последовательный тест принял решение;
+    // тест проверяется после каждых params.batch_seeds_cnt seed, так что результат тоже не зависит от числа потоков
+    FullStatistic run_adaptive(int max_test_steps_cnt, const SequentialTestParams& params, unsigned int seed = -1) {
+        const std::vector<unsigned int> game_seeds = make_game_seeds(max_test_steps_cnt, seed);
+        start_run(game_seeds.size());
+
+        SequentialTest test;
+        SequentialTestResult result = SequentialTestResult::Continue;
+        for (size_t played = 0; played < game_seeds.size() && SequentialTestResult::Continue == result;) {
+            const size_t batch_end = std::min(game_seeds.size(), played + std::max<size_t>(1, params.batch_seeds_cnt));
+            play_seeds(game_seeds, played, batch_end);
+            played = batch_end;
+
+            test.clear();
+            for (auto& worker : workers_)
+                test.merge(worker->statistic.seed_scores);
+            result = test.result(params);
+        }
+        finish_run();
+
+        FullStatistic result_stat = collect_statistic();
+        result_stat.seeds_budget = game_seeds.size();
+        result_stat.sequential_result = result;
+        result_stat.sequential_llr_up = test.llr(0., params.delta);
+        result_stat.sequential_llr_down = test.llr(0., -params.delta);
+        return result_stat;
+    }
+private:
+    void start_run(size_t seeds_cnt) {
+        for (auto& worker : workers_) {
+            worker->statistic = FullStatistic();
+            worker->game_first.clear_decision_latency();
+            worker->game_second.clear_decision_latency();
+            worker->game_first.clear_telemetry();
+            worker->game_second.clear_telemetry();
+        }
+        progress_total_ = seeds_cnt;
+        progress_done_ = 0;
+        progress_clear_.clear();
+    }
+    void play_seeds(const std::vector<unsigned int>& game_seeds, size_t begin, size_t end) {
+        const size_t chunk_size = std::max<size_t>(1, (end - begin) / (16 * pool_.size()));
+        pool_.run(end - begin, chunk_size, [&](size_t worker_idx, size_t chunk_begin, size_t chunk_end) {
+            DURAK_GAME_TRACE_SPAN("DecisionStatistician batch");
+            WorkerGames& worker = *workers_[worker_idx];
+            for (size_t i = begin + chunk_begin; i < begin + chunk_end; i++)
+                play_seed(worker.game_first, worker.game_second, game_seeds[i], worker.statistic, antithetic_deals_);
+
+            std::lock_guard<std::mutex> lock(progress_mutex_);
+            progress_done_ += chunk_end - chunk_begin;
+            for (; progress_clear_.size() < 50 * progress_done_ / progress_total_; progress_clear_ += " ") {
+                std::cerr << "."; std::cerr.flush();
             }
+        });
+    }
+    void finish_run() {
+        std::cerr << "\r" << progress_clear_ << "\r";
+    }
+    FullStatistic collect_statistic() const {
+        FullStatistic result_stat;
+        result_stat.first_decision_name = first_decision_name_;
+        result_stat.second_decision_name = second_decision_name_;
+        result_stat.deals_per_seed = antithetic_deals_ ? 2 : 1;
+        for (auto& worker : workers_) {
+            result_stat.merge(worker->statistic);
+            result_stat.first_decision_latency.merge(worker->game_first.get_decision_latency(0));
+            result_stat.first_decision_latency.merge(worker->game_second.get_decision_latency(1));
+            result_stat.second_decision_latency.merge(worker->game_first.get_decision_latency(1));
+            result_stat.second_decision_latency.merge(worker->game_second.get_decision_latency(0));
+            result_stat.telemetry.merge(worker->game_first.get_telemetry());
+            result_stat.telemetry.merge(worker->game_second.get_telemetry());
         }
-        std::cout << "\r" << clear << "\r";
         return result_stat;
     }
 private:
-    Game<2> game_first_;
-    Game<2> game_second_;
+    std::unique_ptr<WorkStealingPool> own_pool_;
+    WorkStealingPool& pool_;
+    std::string first_decision_name_;
+    std::string second_decision_name_;
+    bool antithetic_deals_;
+    std::vector<std::unique_ptr<WorkerGames>> workers_;
+
+    std::mutex progress_mutex_;
+    size_t progress_total_ = 0;
+    size_t progress_done_ = 0;
+    std::string progress_clear_;
+};
+
+template <class GameHandDecisionFirst, class GameHandDecisionSecond>
+class GameStatistician
+    : public DecisionStatistician
+{
+public:
+    explicit GameStatistician(size_t threads_cnt = 0)
+        : DecisionStatistician(
+            GameHandDecisionFirst::decision_name(), make_decision_factory<GameHandDecisionFirst>(),
+            GameHandDecisionSecond::decision_name(), make_decision_factory<GameHandDecisionSecond>(),
+            threads_cnt)
+    {}
 };
 
 template <int TestCount, typename GameHandDecisionFirst, typename GameHandDecisionSecond>
@@ -260,18 +551,40 @@ void calc_statistic() {
     std::cout << statistician.run(TestCount) << std::endl;
 }
 
+// адаптивный режим: TestCount - максимум seed, остановка по последовательному тесту
+template <int TestCount, typename GameHandDecisionFirst, typename GameHandDecisionSecond>
+void calc_statistic(const SequentialTestParams& params) {
+    GameStatistician<GameHandDecisionFirst, GameHandDecisionSecond> statistician;
+    std::cout << statistician.run_adaptive(TestCount, params) << std::endl;
+}
+
 template <int TestCount, typename GameHandDecisionFirst, typename ... GameHandDecisionTypes>
 void calc_one_to_many_decision_statistic() {
     calc_statistic<TestCount, GameHandDecisionFirst, GameHandDecisionFirst>();
     (calc_statistic<TestCount, GameHandDecisionFirst, GameHandDecisionTypes>(), ...);
 }
 
+template <int TestCount, typename GameHandDecisionFirst, typename ... GameHandDecisionTypes>
+void calc_one_to_many_decision_statistic(const SequentialTestParams& params) {
+    calc_statistic<TestCount, GameHandDecisionFirst, GameHandDecisionFirst>(params);
+    (calc_statistic<TestCount, GameHandDecisionFirst, GameHandDecisionTypes>(params), ...);
+}
+
 template <int TestCount>
 void calc_multi_decision_statistic() {}
 
+template <int TestCount>
+void calc_multi_decision_statistic(const SequentialTestParams& /*params*/) {}
+
 template <int TestCount, typename GameHandDecisionFirst, typename ... GameHandDecisionTypes>
 void calc_multi_decision_statistic() {
     calc_one_to_many_decision_statistic<TestCount, GameHandDecisionFirst, GameHandDecisionTypes...>();
     calc_multi_decision_statistic<TestCount, GameHandDecisionTypes...>();
 }
+
+template <int TestCount, typename GameHandDecisionFirst, typename ... GameHandDecisionTypes>
+void calc_multi_decision_statistic(const SequentialTestParams& params) {
+    calc_one_to_many_decision_statistic<TestCount, GameHandDecisionFirst, GameHandDecisionTypes...>(params);
+    calc_multi_decision_statistic<TestCount, GameHandDecisionTypes...>(params);
+}
 } //namespace durak_game
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include "durak_game_statistic.hpp"
+#include "durak_game_statistic_shard.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// CheckpointedRun
+namespace durak_game {
+/*
+    Long statistic run with periodic checkpoints.
+
+    Seeds come from the same generator as make_game_seeds(seeds_total, seed),
+    but are generated by portions of checkpoint_seeds_cnt seeds, so the whole
+    seed list is never kept in memory. After every portion the run saves a
+    StatisticShard of the played prefix [0, next seed index) with the
+    generator state (atomically, through rename). With resume the run loads
+    the checkpoint, restores the generator and plays only the rest of the
+    seeds, so the final counters are the same as of the uninterrupted run.
+    The checkpoint of the finished run is a complete shard for durak_merge.
+*/
+struct CheckpointedRunParams {
+    size_t seeds_total = 0;
+    unsigned int seed = 1;
+    bool antithetic_deals = false;
+    std::string checkpoint_path;
+    size_t checkpoint_seeds_cnt = 10000;
+    bool resume = false;
+};
+
+inline StatisticShard run_with_checkpoints(DecisionStatistician& statistician, const CheckpointedRunParams& params) {
+    StatisticShard state;
+    std::mt19937 generator(params.seed);
+    size_t next_seed_idx = 0;
+
+    if (params.resume) {
+        std::string error;
+        if (!state.load(params.checkpoint_path, error))
+            throw std::runtime_error("Unable to resume from " + params.checkpoint_path + ": " + error);
+        if (state.seed != params.seed || state.seeds_total != params.seeds_total
+            || state.antithetic_deals != params.antithetic_deals
+            || state.statistic.first_decision_name != statistician.first_decision_name()
+            || state.statistic.second_decision_name != statistician.second_decision_name())
+            throw std::runtime_error("Checkpoint " + params.checkpoint_path + " is of another run");
+        if (1 < state.seed_ranges.size() || (1 == state.seed_ranges.size() && 0 != state.seed_ranges[0].first))
+            throw std::runtime_error("Checkpoint " + params.checkpoint_path + " is not a prefix of the run");
+        next_seed_idx = state.seeds_cnt();
+        if (0 < next_seed_idx) {
+            std::istringstream rng_state(state.rng_state);
+            rng_state >> generator;
+            if (!rng_state)
+                throw std::runtime_error("Checkpoint " + params.checkpoint_path + " has no generator state");
+        }
+        std::cerr << "Resume from seed " << next_seed_idx << " of " << params.seeds_total << std::endl;
+    } else {
+        state.seed = params.seed;
+        state.seeds_total = params.seeds_total;
+        state.antithetic_deals = params.antithetic_deals;
+        state.statistic.first_decision_name = statistician.first_decision_name();
+        state.statistic.second_decision_name = statistician.second_decision_name();
+        state.statistic.deals_per_seed = params.antithetic_deals ? 2 : 1;
+    }
+
+    statistician.set_antithetic_deals(params.antithetic_deals);
+    std::vector<unsigned int> game_seeds;
+    while (next_seed_idx < params.seeds_total) {
+        const size_t portion = std::min(std::max<size_t>(1, params.checkpoint_seeds_cnt), params.seeds_total - next_seed_idx);
+        game_seeds.resize(portion);
+        for (auto& game_seed : game_seeds)
+            game_seed = generator();
+
+        state.statistic.merge(statistician.run_seeds(game_seeds));
+        next_seed_idx += portion;
+        state.seed_ranges.assign(1, { 0, next_seed_idx });
+
+        std::ostringstream rng_state;
+        rng_state << generator;
+        state.rng_state = rng_state.str();
+        if (!state.save(params.checkpoint_path))
+            throw std::runtime_error("Unable to write checkpoint " + params.checkpoint_path);
+    }
+    return state;
+}
+} // namespace durak_game
@@ -0,0 +1,391 @@
+#pragma once
+#include "durak_game_sequential_test.hpp"
+#include "durak_game_statistic.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// json
+namespace durak_game {
+namespace json {
+/*
+    Minimal JSON reader for the files written by this project:
+    objects, arrays, strings without unicode escapes, numbers, true/false/null.
+    Numbers keep their text, so 64-bit counters are read exactly.
+*/
+struct Value {
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    bool boolean = false;
+    std::string text; // Number and String
+    std::vector<Value> items;
+    std::vector<std::pair<std::string, Value>> members;
+
+    const Value* find(const std::string& key) const {
+        for (const auto& member : members) {
+            if (member.first == key)
+                return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+class Reader
+{
+public:
+    explicit Reader(const std::string& text)
+        : text_(text)
+        , pos_(0) {}
+
+    bool parse(Value& value) {
+        if (!parse_value(value))
+            return false;
+        skip_spaces();
+        return pos_ == text_.size();
+    }
+private:
+    void skip_spaces() {
+        while (pos_ < text_.size() && std::isspace((unsigned char)text_[pos_]))
+            pos_++;
+    }
+    bool consume(char c) {
+        skip_spaces();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+    bool consume_word(const char* word) {
+        const std::string w(word);
+        if (0 != text_.compare(pos_, w.size(), w))
+            return false;
+        pos_ += w.size();
+        return true;
+    }
+    bool parse_string(std::string& result) {
+        if (!consume('"'))
+            return false;
+        result.clear();
+        while (pos_ < text_.size() && '"' != text_[pos_]) {
+            char c = text_[pos_++];
+            if ('\\' == c) {
+                if (pos_ == text_.size())
+                    return false;
+                c = text_[pos_++];
+                switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '"': case '\\': case '/': break;
+                default: return false;
+                }
+            }
+            result += c;
+        }
+        return consume('"');
+    }
+    bool parse_value(Value& value) {
+        skip_spaces();
+        if (pos_ == text_.size())
+            return false;
+        const char c = text_[pos_];
+        if ('{' == c) {
+            pos_++;
+            value.type = Value::Object;
+            if (consume('}'))
+                return true;
+            do {
+                std::pair<std::string, Value> member;
+                if (!parse_string(member.first) || !consume(':') || !parse_value(member.second))
+                    return false;
+                value.members.push_back(std::move(member));
+            } while (consume(','));
+            return consume('}');
+        }
+        if ('[' == c) {
+            pos_++;
+            value.type = Value::Array;
+            if (consume(']'))
+                return true;
+            do {
+                value.items.emplace_back();
+                if (!parse_value(value.items.back()))
+                    return false;
+            } while (consume(','));
+            return consume(']');
+        }
+        if ('"' == c) {
+            value.type = Value::String;
+            return parse_string(value.text);
+        }
+        if (consume_word("true")) {
+            value.type = Value::Bool;
+            value.boolean = true;
+            return true;
+        }
+        if (consume_word("false")) {
+            value.type = Value::Bool;
+            return true;
+        }
+        if (consume_word("null"))
+            return true;
+
+        const size_t start = pos_;
+        while (pos_ < text_.size() && (std::isdigit((unsigned char)text_[pos_]) || std::strchr("+-.eE", text_[pos_])))
+            pos_++;
+        if (start == pos_)
+            return false;
+        value.type = Value::Number;
+        value.text = text_.substr(start, pos_ - start);
+        return true;
+    }
+private:
+    const std::string& text_;
+    size_t pos_;
+};
+
+inline std::string quoted(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        if ('"' == c || '\\' == c)
+            result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+} // namespace json
+} // namespace durak_game
+
+// StatisticShard
+namespace durak_game {
+/*
+    Partial FullStatistic of a seed range with metadata, for runs split
+    across processes and machines.
+
+    Every process plays seeds [begin, end) of make_game_seeds(seeds_total, seed)
+    and saves a shard as JSON. Shards of the same run (same decisions, seed,
+    seeds_total and deal mode) with disjoint ranges merge exactly into the
+    statistic of the uninterrupted run. Decision latency and game telemetry
+    are not stored.
+*/
+struct StatisticShard {
+    static constexpr const char* format_name = "durak_game_statistic_shard";
+    static constexpr int format_version = 1;
+
+    unsigned int seed = 0;
+    size_t seeds_total = 0;
+    bool antithetic_deals = false;
+    std::vector<std::pair<size_t, size_t>> seed_ranges; // sorted, disjoint, [begin, end)
+    FullStatistic statistic;
+    std::string rng_state; // checkpoints only: seed generator after the last played seed
+
+    size_t seeds_cnt() const {
+        size_t cnt = 0;
+        for (const auto& range : seed_ranges)
+            cnt += range.second - range.first;
+        return cnt;
+    }
+    bool complete() const {
+        return seeds_cnt() == seeds_total;
+    }
+
+    bool merge(const StatisticShard& other, std::string& error) {
+        if (statistic.first_decision_name != other.statistic.first_decision_name ||
+            statistic.second_decision_name != other.statistic.second_decision_name) {
+            error = "different decisions";
+            return false;
+        }
+        if (seed != other.seed || seeds_total != other.seeds_total || antithetic_deals != other.antithetic_deals) {
+            error = "different run parameters";
+            return false;
+        }
+        std::vector<std::pair<size_t, size_t>> ranges = seed_ranges;
+        ranges.insert(ranges.end(), other.seed_ranges.begin(), other.seed_ranges.end());
+        std::sort(ranges.begin(), ranges.end());
+        std::vector<std::pair<size_t, size_t>> merged;
+        for (const auto& range : ranges) {
+            if (!merged.empty() && range.first < merged.back().second) {
+                error = "overlapping seed ranges";
+                return false;
+            }
+            if (!merged.empty() && range.first == merged.back().second)
+                merged.back().second = range.second;
+            else
+                merged.push_back(range);
+        }
+        seed_ranges = merged;
+        statistic.merge(other.statistic);
+        rng_state.clear();
+        return true;
+    }
+
+    std::string to_json() const {
+        auto game_statistic = [](const GameStatistic& stat) {
+            std::ostringstream stream;
+            stream
+                << "{ \"first_decision_win\": " << stat.first_decision_win
+                << ", \"second_decision_win\": " << stat.second_decision_win
+                << ", \"draw\": " << stat.draw << " }";
+            return stream.str();
+        };
+        std::ostringstream stream;
+        stream << std::setprecision(std::numeric_limits<double>::max_digits10);
+        stream
+            << "{" << std::endl
+            << "  \"format\": " << json::quoted(format_name) << "," << std::endl
+            << "  \"version\": " << format_version << "," << std::endl
+            << "  \"first_decision\": " << json::quoted(statistic.first_decision_name) << "," << std::endl
+            << "  \"second_decision\": " << json::quoted(statistic.second_decision_name) << "," << std::endl
+            << "  \"seed\": " << seed << "," << std::endl
+            << "  \"seeds_total\": " << seeds_total << "," << std::endl
+            << "  \"antithetic_deals\": " << (antithetic_deals ? "true" : "false") << "," << std::endl
+            << "  \"seed_ranges\": [";
+        for (size_t i = 0; i < seed_ranges.size(); i++)
+            stream << (0 == i ? "" : ", ") << "[" << seed_ranges[i].first << ", " << seed_ranges[i].second << "]";
+        stream
+            << "]," << std::endl
+            << "  \"first_decision_start\": " << game_statistic(statistic.first_decision_start) << "," << std::endl
+            << "  \"second_decision_start\": " << game_statistic(statistic.second_decision_start) << "," << std::endl
+            << "  \"seed_scores\": { \"samples_cnt\": " << statistic.seed_scores.samples_cnt()
+            << ", \"sum\": " << statistic.seed_scores.sum()
+            << ", \"sq_sum\": " << statistic.seed_scores.sq_sum() << " }";
+        if (!rng_state.empty())
+            stream << "," << std::endl << "  \"rng_state\": " << json::quoted(rng_state);
+        stream
+            << std::endl
+            << "}" << std::endl;
+        return stream.str();
+    }
+
+    bool from_json(const std::string& text, std::string& error) {
+        json::Value root;
+        if (!json::Reader(text).parse(root) || json::Value::Object != root.type) {
+            error = "invalid JSON";
+            return false;
+        }
+        auto member = [&](const json::Value& object, const char* key, json::Value::Type type) -> const json::Value* {
+            const json::Value* value = object.find(key);
+            if (nullptr == value || type != value->type) {
+                error = std::string("missing or invalid \"") + key + "\"";
+                return nullptr;
+            }
+            return value;
+        };
+        auto number = [&](const json::Value& object, const char* key, auto& result) {
+            const json::Value* value = member(object, key, json::Value::Number);
+            if (nullptr == value)
+                return false;
+            std::istringstream stream(value->text);
+            stream >> result;
+            if (!stream) {
+                error = std::string("invalid number \"") + key + "\"";
+                return false;
+            }
+            return true;
+        };
+        auto game_statistic = [&](const char* key, GameStatistic& stat) {
+            const json::Value* value = member(root, key, json::Value::Object);
+            return nullptr != value
+                && number(*value, "first_decision_win", stat.first_decision_win)
+                && number(*value, "second_decision_win", stat.second_decision_win)
+                && number(*value, "draw", stat.draw);
+        };
+
+        const json::Value* format = member(root, "format", json::Value::String);
+        if (nullptr == format)
+            return false;
+        int version = 0;
+        if (format_name != format->text || !number(root, "version", version) || format_version != version) {
+            error = "unsupported format";
+            return false;
+        }
+        const json::Value* first = member(root, "first_decision", json::Value::String);
+        const json::Value* second = member(root, "second_decision", json::Value::String);
+        const json::Value* antithetic = member(root, "antithetic_deals", json::Value::Bool);
+        const json::Value* ranges = member(root, "seed_ranges", json::Value::Array);
+        const json::Value* scores = member(root, "seed_scores", json::Value::Object);
+        if (nullptr == first || nullptr == second || nullptr == antithetic || nullptr == ranges || nullptr == scores)
+            return false;
+        *this = StatisticShard();
+        statistic.first_decision_name = first->text;
+        statistic.second_decision_name = second->text;
+        antithetic_deals = antithetic->boolean;
+        statistic.deals_per_seed = antithetic_deals ? 2 : 1;
+        if (!number(root, "seed", seed) || !number(root, "seeds_total", seeds_total))
+            return false;
+        for (const auto& range : ranges->items) {
+            if (json::Value::Array != range.type || 2 != range.items.size()) {
+                error = "invalid seed range";
+                return false;
+            }
+            size_t begin = 0, end = 0;
+            std::istringstream(range.items[0].text) >> begin;
+            std::istringstream(range.items[1].text) >> end;
+            if (end < begin || seeds_total < end) {
+                error = "invalid seed range";
+                return false;
+            }
+            seed_ranges.push_back({ begin, end });
+        }
+        size_t samples_cnt = 0;
+        double sum = 0., sq_sum = 0.;
+        if (!game_statistic("first_decision_start", statistic.first_decision_start)
+            || !game_statistic("second_decision_start", statistic.second_decision_start)
+            || !number(*scores, "samples_cnt", samples_cnt)
+            || !number(*scores, "sum", sum)
+            || !number(*scores, "sq_sum", sq_sum))
+            return false;
+        statistic.seed_scores = SequentialTest(samples_cnt, sum, sq_sum);
+        if (const json::Value* state = root.find("rng_state"))
+            rng_state = state->text;
+        return true;
+    }
+
+    // to a temporary file, then rename over path
+    bool save(const std::string& path) const {
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::trunc);
+            file << to_json();
+            if (!file)
+                return false;
+        }
+#ifdef _WIN32
+        // rename does not replace existing file on Windows
+        std::remove(path.c_str());
+#endif
+        return 0 == std::rename(tmp_path.c_str(), path.c_str());
+    }
+    bool load(const std::string& path, std::string& error) {
+        std::ifstream file(path);
+        if (!file) {
+            error = "unable to open " + path;
+            return false;
+        }
+        std::ostringstream text;
+        text << file.rdbuf();
+        return from_json(text.str(), error);
+    }
+
+    friend std::ostream& operator<< (std::ostream& stream, const StatisticShard& shard) {
+        stream << shard.statistic;
+        stream << "Seeds: " << shard.seeds_cnt() << " of " << shard.seeds_total << " from seed " << shard.seed << ", ranges:";
+        for (const auto& range : shard.seed_ranges)
+            stream << " [" << range.first << ", " << range.second << ")";
+        stream << std::endl;
+        return stream;
+    }
+};
+} // namespace durak_game
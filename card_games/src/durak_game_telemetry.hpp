@@ -0,0 +1,155 @@
+#pragma once
+
+#include "durak_game_latency.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// DURAK_GAME_TELEMETRY=1 turns on the game shape counters of Game,
+// without it all telemetry hooks of Game compile to nothing
+#ifndef DURAK_GAME_TELEMETRY
+#define DURAK_GAME_TELEMETRY 0
+#endif
+
+// GameTelemetry
+namespace durak_game {
+constexpr bool game_telemetry_enabled = (0 != DURAK_GAME_TELEMETRY);
+
+/*
+    Game shape counters: steps and decision time by stage, tricks, takes,
+    cards per trick and tricks per game.
+
+    Every Game keeps own counters, so a worker thread updates them without
+    synchronization; statisticians merge the counters of all worker games
+    at the end of a run. Counts are deterministic for fixed seeds, decision
+    time is machine dependent.
+*/
+struct GameTelemetry {
+    static constexpr size_t stages_cnt = DecisionLatency::LatencyStageCnt;
+    static constexpr size_t max_trick_cards = 12;  // the last bucket of the histogram is "and more"
+    static constexpr size_t max_game_tricks = 48;
+
+    uint64_t games = 0;
+    uint64_t tricks = 0;
+    uint64_t takes = 0;
+    uint64_t trick_cards = 0;
+    std::array<uint64_t, stages_cnt> steps{};           // = decisions of the stage
+    std::array<uint64_t, stages_cnt> decision_ns{};
+    std::array<uint64_t, max_trick_cards + 1> trick_cards_histogram{};
+    std::array<uint64_t, max_game_tricks + 1> game_tricks_histogram{};
+
+    void add_decision(DecisionLatency::LatencyStage stage, std::chrono::nanoseconds time) {
+        steps[stage]++;
+        decision_ns[stage] += (uint64_t)time.count();
+    }
+    void add_trick(size_t cards_cnt, bool take) {
+        tricks++;
+        takes += take ? 1 : 0;
+        trick_cards += cards_cnt;
+        trick_cards_histogram[std::min(cards_cnt, max_trick_cards)]++;
+    }
+    void add_game(size_t tricks_cnt) {
+        games++;
+        game_tricks_histogram[std::min(tricks_cnt, max_game_tricks)]++;
+    }
+
+    void merge(const GameTelemetry& other) {
+        games += other.games;
+        tricks += other.tricks;
+        takes += other.takes;
+        trick_cards += other.trick_cards;
+        for (size_t i = 0; i < stages_cnt; i++) {
+            steps[i] += other.steps[i];
+            decision_ns[i] += other.decision_ns[i];
+        }
+        for (size_t i = 0; i < trick_cards_histogram.size(); i++)
+            trick_cards_histogram[i] += other.trick_cards_histogram[i];
+        for (size_t i = 0; i < game_tricks_histogram.size(); i++)
+            game_tricks_histogram[i] += other.game_tricks_histogram[i];
+    }
+    void clear() {
+        *this = GameTelemetry();
+    }
+    bool empty() const {
+        return 0 == games && 0 == tricks;
+    }
+
+    uint64_t decisions() const {
+        uint64_t cnt = 0;
+        for (const auto step_cnt : steps)
+            cnt += step_cnt;
+        return cnt;
+    }
+    double mean_decision_ns(DecisionLatency::LatencyStage stage) const {
+        return (0 == steps[stage]) ? 0. : (double)decision_ns[stage] / (double)steps[stage];
+    }
+    double mean_trick_cards() const {
+        return (0 == tricks) ? 0. : (double)trick_cards / (double)tricks;
+    }
+    double mean_game_tricks() const {
+        return (0 == games) ? 0. : (double)tricks / (double)games;
+    }
+    double mean_game_decisions() const {
+        return (0 == games) ? 0. : (double)decisions() / (double)games;
+    }
+
+    friend std::ostream& operator<< (std::ostream& stream, const GameTelemetry& telemetry) {
+        stream
+            << "  games: " << telemetry.games
+            << ", tricks per game: " << telemetry.mean_game_tricks()
+            << ", decisions per game: " << telemetry.mean_game_decisions()
+            << std::endl
+            << "  tricks: " << telemetry.tricks
+            << ", takes: " << telemetry.takes
+            << ", cards per trick: " << telemetry.mean_trick_cards()
+            << std::endl;
+        for (size_t i = 0; i < stages_cnt; i++) {
+            const DecisionLatency::LatencyStage stage = (DecisionLatency::LatencyStage)i;
+            stream
+                << "  " << std::left << std::setw(8) << DecisionLatency::stage_name(stage) << std::right
+                << " steps: " << std::setw(10) << telemetry.steps[i]
+                << " mean decision (ns): " << std::setw(8) << (uint64_t)telemetry.mean_decision_ns(stage)
+                << std::endl;
+        }
+        return stream;
+    }
+
+    /*
+        Dump in the Prometheus text exposition format, one sample per line:
+            durak_game_tricks_total{first="A",second="B"} 123
+        labels is the text inside the braces, may be empty.
+    */
+    void write_metrics(std::ostream& stream, const std::string& labels) const {
+        const std::string braces = labels.empty() ? std::string() : "{" + labels + "}";
+        auto with_label = [&](const std::string& label) {
+            return "{" + (labels.empty() ? label : labels + "," + label) + "}";
+        };
+        stream
+            << "durak_game_games_total" << braces << " " << games << "\n"
+            << "durak_game_tricks_total" << braces << " " << tricks << "\n"
+            << "durak_game_takes_total" << braces << " " << takes << "\n"
+            << "durak_game_trick_cards_total" << braces << " " << trick_cards << "\n";
+        for (size_t i = 0; i < stages_cnt; i++) {
+            const std::string stage = std::string("stage=\"") + DecisionLatency::stage_name((DecisionLatency::LatencyStage)i) + "\"";
+            stream
+                << "durak_game_steps_total" << with_label(stage) << " " << steps[i] << "\n"
+                << "durak_game_decision_seconds_total" << with_label(stage) << " " << (double)decision_ns[i] * 1e-9 << "\n";
+        }
+        for (size_t i = 0; i < trick_cards_histogram.size(); i++) {
+            const std::string cards = "cards=\"" + std::to_string(i) + (max_trick_cards == i ? "+" : "") + "\"";
+            stream << "durak_game_tricks_by_cards" << with_label(cards) << " " << trick_cards_histogram[i] << "\n";
+        }
+        for (size_t i = 0; i < game_tricks_histogram.size(); i++) {
+            if (0 == game_tricks_histogram[i])
+                continue;
+            const std::string tricks_cnt = "tricks=\"" + std::to_string(i) + (max_game_tricks == i ? "+" : "") + "\"";
+            stream << "durak_game_games_by_tricks" << with_label(tricks_cnt) << " " << game_tricks_histogram[i] << "\n";
+        }
+    }
+};
+} // namespace durak_game
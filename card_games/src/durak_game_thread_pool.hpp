@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// WorkStealingPool
+namespace durak_game {
+/*
+    Persistent pool of worker threads for index ranges.
+
+    run(items_cnt, chunk_size, job) splits [0, items_cnt) into chunks, gives
+    every worker a contiguous block of chunks and blocks until all chunks are
+    done, calls of run from different threads are serialized. A worker takes
+    chunks from the front of its own queue, and steals from the back of other
+    queues when its own is empty.
+    job(worker_idx, begin, end) is called for every chunk, worker_idx lets the
+    job keep per-worker state without locks.
+*/
+class WorkStealingPool
+{
+public:
+    using Job = std::function<void(size_t /*worker_idx*/, size_t /*begin*/, size_t /*end*/)>;
+public:
+    explicit WorkStealingPool(size_t threads_cnt = 0)
+        : job_(nullptr)
+        , generation_(0)
+        , active_workers_(0)
+        , stop_(false)
+    {
+        if (0 == threads_cnt)
+            threads_cnt = std::max<size_t>(1, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < threads_cnt; i++)
+            queues_.emplace_back(new WorkerQueue());
+        for (size_t i = 0; i < threads_cnt; i++)
+            threads_.emplace_back(&WorkStealingPool::worker_loop, this, i);
+    }
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto& thread : threads_)
+            thread.join();
+    }
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t size() const {
+        return threads_.size();
+    }
+
+    void run(size_t items_cnt, size_t chunk_size, const Job& job) {
+        if (0 == items_cnt)
+            return;
+        if (0 == chunk_size)
+            chunk_size = 1;
+
+        std::lock_guard<std::mutex> run_lock(run_mutex_);
+        std::unique_lock<std::mutex> lock(mutex_);
+        const size_t chunks_cnt = (items_cnt + chunk_size - 1) / chunk_size;
+        const size_t workers_cnt = queues_.size();
+        for (size_t worker = 0; worker < workers_cnt; worker++) {
+            const size_t first_chunk = chunks_cnt * worker / workers_cnt;
+            const size_t last_chunk = chunks_cnt * (worker + 1) / workers_cnt;
+            std::lock_guard<std::mutex> queue_lock(queues_[worker]->mutex);
+            for (size_t chunk = first_chunk; chunk < last_chunk; chunk++) {
+                queues_[worker]->ranges.push_back({
+                    chunk * chunk_size,
+                    std::min(items_cnt, (chunk + 1) * chunk_size) });
+            }
+        }
+        job_ = &job;
+        error_ = nullptr;
+        active_workers_ = workers_cnt;
+        generation_++;
+        start_cv_.notify_all();
+        done_cv_.wait(lock, [this]() { return 0 == active_workers_; });
+        job_ = nullptr;
+        if (error_)
+            std::rethrow_exception(error_);
+    }
+
+    // pool with all cores, shared by the process
+    static WorkStealingPool& shared() {
+        static WorkStealingPool pool;
+        return pool;
+    }
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    bool pop_range(size_t worker_idx, Range& range) {
+        {
+            WorkerQueue& own = *queues_[worker_idx];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.ranges.empty()) {
+                range = own.ranges.front();
+                own.ranges.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues_.size(); i++) {
+            WorkerQueue& victim = *queues_[(worker_idx + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.ranges.empty()) {
+                range = victim.ranges.back();
+                victim.ranges.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+    void worker_loop(size_t worker_idx) {
+        size_t done_generation = 0;
+        for (;;) {
+            const Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock, [&]() { return stop_ || generation_ != done_generation; });
+                if (stop_)
+                    return;
+                done_generation = generation_;
+                job = job_;
+            }
+            Range range;
+            while (pop_range(worker_idx, range)) {
+                try {
+                    (*job)(worker_idx, range.begin, range.end);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!error_)
+                        error_ = std::current_exception();
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (0 == --active_workers_)
+                    done_cv_.notify_all();
+            }
+        }
+    }
+private:
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const Job* job_;
+    size_t generation_;
+    size_t active_workers_;
+    std::exception_ptr error_;
+    bool stop_;
+};
+} // namespace durak_game
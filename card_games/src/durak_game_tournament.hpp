@@ -0,0 +1,477 @@
+#pragma once
+#include "durak_game.hpp"
+#include "durak_game_statistic.hpp"
+#include "durak_game_thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// TournamentRating
+namespace durak_game {
+struct TournamentRating {
+    std::string name;
+    double elo = 0.;           // mean of all ratings is 0
+    double elo_interval = 0.;  // half-width of the 95% confidence interval
+};
+
+/*
+    Bradley-Terry ratings on the Elo scale.
+
+    scores[i][j] - points of i against j (win - 1, draw - 1/2),
+    games[i][j]  - games between i and j.
+    Strengths are fitted by the MM algorithm (Hunter, 2004). One virtual draw
+    per played pairing keeps ratings finite when a decision never scores.
+    Confidence intervals come from the inverse Fisher information with the
+    last rating fixed, then moved to the zero-mean ratings.
+*/
+inline std::vector<TournamentRating> bradley_terry_ratings(
+    const std::vector<std::string>& names,
+    const std::vector<std::vector<double>>& scores,
+    const std::vector<std::vector<double>>& games)
+{
+    const size_t cnt = names.size();
+    std::vector<TournamentRating> ratings(cnt);
+    for (size_t i = 0; i < cnt; i++)
+        ratings[i].name = names[i];
+    if (cnt < 2)
+        return ratings;
+
+    std::vector<std::vector<double>> n(cnt, std::vector<double>(cnt, 0.));
+    std::vector<double> wins(cnt, 0.);
+    for (size_t i = 0; i < cnt; i++) {
+        for (size_t j = 0; j < cnt; j++) {
+            if (i == j || 0. == games[i][j])
+                continue;
+            n[i][j] = games[i][j] + 1.;
+            wins[i] += scores[i][j] + 0.5;
+        }
+    }
+
+    std::vector<double> gamma(cnt, 1.);
+    for (size_t iter = 0; iter < 10000; iter++) {
+        double max_change = 0.;
+        std::vector<double> next(cnt, 1.);
+        double log_sum = 0.;
+        for (size_t i = 0; i < cnt; i++) {
+            double denominator = 0.;
+            for (size_t j = 0; j < cnt; j++) {
+                if (0. < n[i][j])
+                    denominator += n[i][j] / (gamma[i] + gamma[j]);
+            }
+            next[i] = (0. < denominator) ? wins[i] / denominator : 1.;
+            log_sum += std::log(next[i]);
+        }
+        const double norm = std::exp(log_sum / (double)cnt);
+        for (size_t i = 0; i < cnt; i++) {
+            next[i] /= norm;
+            max_change = std::max(max_change, std::fabs(std::log(next[i] / gamma[i])));
+        }
+        gamma.swap(next);
+        if (max_change < 1e-10)
+            break;
+    }
+
+    // information matrix of natural-log strengths without the last one
+    const size_t dim = cnt - 1;
+    std::vector<std::vector<double>> info(dim, std::vector<double>(2 * dim, 0.));
+    for (size_t i = 0; i < dim; i++) {
+        for (size_t j = 0; j < cnt; j++) {
+            if (0. == n[i][j])
+                continue;
+            const double p = gamma[i] / (gamma[i] + gamma[j]);
+            const double w = games[i][j] * p * (1. - p);
+            info[i][i] += w;
+            if (j < dim)
+                info[i][j] -= w;
+        }
+        info[i][dim + i] = 1.;
+    }
+    // Gauss-Jordan inversion, right half becomes the covariance
+    bool singular = false;
+    for (size_t col = 0; col < dim && !singular; col++) {
+        size_t pivot = col;
+        for (size_t row = col + 1; row < dim; row++) {
+            if (std::fabs(info[row][col]) > std::fabs(info[pivot][col]))
+                pivot = row;
+        }
+        if (std::fabs(info[pivot][col]) < 1e-12) {
+            singular = true;
+            break;
+        }
+        std::swap(info[col], info[pivot]);
+        const double diag = info[col][col];
+        for (auto& value : info[col])
+            value /= diag;
+        for (size_t row = 0; row < dim; row++) {
+            if (row == col || 0. == info[row][col])
+                continue;
+            const double factor = info[row][col];
+            for (size_t k = 0; k < 2 * dim; k++)
+                info[row][k] -= factor * info[col][k];
+        }
+    }
+
+    const double elo_scale = 400. / std::log(10.);
+    for (size_t i = 0; i < cnt; i++)
+        ratings[i].elo = elo_scale * std::log(gamma[i]);
+    if (singular)
+        return ratings;
+
+    // var(r_i - mean(r)) with r_last == 0
+    auto cov = [&](size_t i, size_t j) {
+        return (i < dim && j < dim) ? info[i][dim + j] : 0.;
+    };
+    std::vector<double> row_mean(cnt, 0.);
+    double total_mean = 0.;
+    for (size_t i = 0; i < cnt; i++) {
+        for (size_t j = 0; j < cnt; j++)
+            row_mean[i] += cov(i, j);
+        row_mean[i] /= (double)cnt;
+        total_mean += row_mean[i];
+    }
+    total_mean /= (double)cnt;
+    for (size_t i = 0; i < cnt; i++) {
+        const double variance = cov(i, i) - 2. * row_mean[i] + total_mean;
+        ratings[i].elo_interval = 1.96 * elo_scale * std::sqrt(std::max(0., variance));
+    }
+    return ratings;
+}
+} // namespace durak_game
+
+// TournamentResult
+namespace durak_game {
+struct TournamentResult {
+    std::vector<std::string> decision_names;
+    // statistic[{ i, j }], i < j: decision i is the first decision
+    std::map<std::pair<size_t, size_t>, FullStatistic> statistic;
+    std::vector<TournamentRating> ratings;
+
+    size_t played_pairings_cnt = 0;
+    size_t cached_pairings_cnt = 0;
+
+    // points of decision i against decision j (draw - 1/2)
+    double score(size_t i, size_t j) const {
+        const bool swapped = j < i;
+        auto it = statistic.find(swapped ? std::make_pair(j, i) : std::make_pair(i, j));
+        if (statistic.end() == it)
+            return 0.;
+        const size_t wins = swapped ? it->second.second_decision_win() : it->second.first_decision_win();
+        return (double)wins + 0.5 * (double)it->second.draw();
+    }
+    size_t games_count(size_t i, size_t j) const {
+        auto it = statistic.find(j < i ? std::make_pair(j, i) : std::make_pair(i, j));
+        return (statistic.end() == it) ? 0 : it->second.games_count();
+    }
+
+    void update_ratings() {
+        const size_t cnt = decision_names.size();
+        std::vector<std::vector<double>> scores(cnt, std::vector<double>(cnt, 0.));
+        std::vector<std::vector<double>> games(cnt, std::vector<double>(cnt, 0.));
+        for (size_t i = 0; i < cnt; i++) {
+            for (size_t j = 0; j < cnt; j++) {
+                if (i == j)
+                    continue;
+                scores[i][j] = score(i, j);
+                games[i][j] = (double)games_count(i, j);
+            }
+        }
+        ratings = bradley_terry_ratings(decision_names, scores, games);
+    }
+
+    friend std::ostream& operator<< (std::ostream& stream, const TournamentResult& result) {
+        const size_t cnt = result.decision_names.size();
+        stream
+            << "Tournament: " << cnt << " decisions, "
+            << result.played_pairings_cnt << " pairings played, "
+            << result.cached_pairings_cnt << " pairings from cache"
+            << std::endl;
+        /////////////////////////////////////////////////////////////
+        stream << "Score matrix (row vs column, %):" << std::endl;
+        stream << "     ";
+        for (size_t j = 0; j < cnt; j++)
+            stream << std::setw(8) << ("#" + std::to_string(j));
+        stream << std::endl;
+        for (size_t i = 0; i < cnt; i++) {
+            stream << std::setw(5) << ("#" + std::to_string(i));
+            for (size_t j = 0; j < cnt; j++) {
+                const size_t games = result.games_count(i, j);
+                if (i == j || 0 == games)
+                    stream << std::setw(8) << "-";
+                else
+                    stream << std::setw(8) << std::fixed << std::setprecision(2)
+                        << 100. * result.score(i, j) / (double)games;
+            }
+            stream << "  " << result.decision_names[i] << std::endl;
+        }
+        /////////////////////////////////////////////////////////////
+        std::vector<TournamentRating> ratings = result.ratings;
+        std::stable_sort(ratings.begin(), ratings.end(),
+            [](const TournamentRating& a, const TournamentRating& b) { return a.elo > b.elo; });
+        stream << "Ratings (Bradley-Terry, Elo scale, 95% interval):" << std::endl;
+        for (const auto& rating : ratings) {
+            stream
+                << "  " << std::setw(8) << std::fixed << std::setprecision(1) << rating.elo
+                << " +- " << std::setw(6) << rating.elo_interval
+                << "  " << rating.name
+                << std::endl;
+        }
+        stream << std::defaultfloat;
+        return stream;
+    }
+};
+} // namespace durak_game
+
+// Tournament
+namespace durak_game {
+/*
+    Round-robin tournament of decisions.
+
+    All pairings of all decisions share the same game seeds and are played
+    as one set of work items (pairing, seed) on the pool, so no core waits
+    for the slowest pairing. Every pairing plays 4 games per seed like
+    GameStatistician::run with the same seed, and gives the same statistic.
+
+    With cache_path results of pairings are stored in a text file keyed by
+    (decision names, seeds count, seed); pairings found there are not played
+    again, so a new decision only plays its own pairings.
+*/
+class Tournament
+{
+public:
+    // threads_cnt == 0 - shared pool for all cores
+    explicit Tournament(size_t threads_cnt = 0)
+        : own_pool_(0 == threads_cnt ? nullptr : new WorkStealingPool(threads_cnt))
+        , pool_(own_pool_ ? *own_pool_ : WorkStealingPool::shared())
+    {}
+
+    void add_decision(const std::string& name, GameHandDecisionFactory factory) {
+        decisions_.push_back({ name, std::move(factory) });
+    }
+    template <class GameHandDecisionType>
+    void add_decision() {
+        add_decision(GameHandDecisionType::decision_name(), make_decision_factory<GameHandDecisionType>());
+    }
+    template <class... GameHandDecisionTypes>
+    void add_decisions() {
+        (add_decision<GameHandDecisionTypes>(), ...);
+    }
+
+    TournamentResult run(size_t seeds_cnt, unsigned int seed = 1, const std::string& cache_path = "") {
+        TournamentResult result;
+        for (const auto& decision : decisions_)
+            result.decision_names.push_back(decision.name);
+
+        Cache cache;
+        if (!cache_path.empty())
+            cache = load_cache(cache_path);
+
+        std::vector<std::pair<size_t, size_t>> pairings;
+        for (size_t i = 0; i < decisions_.size(); i++) {
+            for (size_t j = i + 1; j < decisions_.size(); j++) {
+                auto it = cache.find(cache_key(decisions_[i].name, decisions_[j].name, seeds_cnt, seed));
+                if (cache.end() != it) {
+                    result.statistic[{ i, j }] = it->second;
+                    result.cached_pairings_cnt++;
+                    continue;
+                }
+                it = cache.find(cache_key(decisions_[j].name, decisions_[i].name, seeds_cnt, seed));
+                if (cache.end() != it) {
+                    result.statistic[{ i, j }] = swapped(it->second);
+                    result.cached_pairings_cnt++;
+                    continue;
+                }
+                pairings.push_back({ i, j });
+            }
+        }
+
+        play_pairings(pairings, make_game_seeds(seeds_cnt, seed), result);
+        result.played_pairings_cnt = pairings.size();
+        for (auto& item : result.statistic) {
+            item.second.first_decision_name = decisions_[item.first.first].name;
+            item.second.second_decision_name = decisions_[item.first.second].name;
+        }
+
+        if (!cache_path.empty() && !pairings.empty()) {
+            for (const auto& pairing : pairings)
+                cache[cache_key(decisions_[pairing.first].name, decisions_[pairing.second].name, seeds_cnt, seed)] =
+                    result.statistic[pairing];
+            save_cache(cache_path, cache);
+        }
+
+        result.update_ratings();
+        return result;
+    }
+private:
+    struct DecisionInfo {
+        std::string name;
+        GameHandDecisionFactory factory;
+    };
+    // games of one pairing on one worker, created by the worker on first use
+    struct PairingGames {
+        Game<2> game_first;
+        Game<2> game_second;
+        FullStatistic statistic;
+    };
+    using WorkerPairings = std::vector<std::unique_ptr<PairingGames>>;
+
+    // first name, second name, seeds count, seed
+    using CacheKey = std::tuple<std::string, std::string, size_t, unsigned int>;
+    using Cache = std::map<CacheKey, FullStatistic>;
+    static constexpr const char* cache_header = "# durak_game tournament cache v1";
+
+    static CacheKey cache_key(const std::string& first, const std::string& second, size_t seeds_cnt, unsigned int seed) {
+        return CacheKey(first, second, seeds_cnt, seed);
+    }
+
+    // statistic of the same games with first and second decisions exchanged
+    static FullStatistic swapped(const FullStatistic& statistic) {
+        auto swap_sides = [](const GameStatistic& stat) {
+            GameStatistic result;
+            result.first_decision_win = stat.second_decision_win;
+            result.second_decision_win = stat.first_decision_win;
+            result.draw = stat.draw;
+            return result;
+        };
+        FullStatistic result;
+        result.first_decision_start = swap_sides(statistic.second_decision_start);
+        result.second_decision_start = swap_sides(statistic.first_decision_start);
+        return result;
+    }
+
+    void play_pairings(const std::vector<std::pair<size_t, size_t>>& pairings,
+                       const std::vector<unsigned int>& game_seeds,
+                       TournamentResult& result) {
+        const size_t seeds_cnt = game_seeds.size();
+        const size_t items_cnt = pairings.size() * seeds_cnt;
+        if (0 == items_cnt)
+            return;
+
+        std::vector<WorkerPairings> workers(pool_.size());
+        for (auto& worker : workers)
+            worker.resize(pairings.size());
+        std::mutex progress_mutex;
+        size_t progress_done = 0;
+        std::string progress_clear;
+
+        const size_t chunk_size = std::max<size_t>(1, items_cnt / (16 * pool_.size()));
+        pool_.run(items_cnt, chunk_size, [&](size_t worker_idx, size_t begin, size_t end) {
+            DURAK_GAME_TRACE_SPAN("Tournament batch");
+            WorkerPairings& worker = workers[worker_idx];
+            for (size_t item = begin; item < end; item++) {
+                const size_t pairing_idx = item / seeds_cnt;
+                std::unique_ptr<PairingGames>& games = worker[pairing_idx];
+                if (!games)
+                    games = make_pairing_games(pairings[pairing_idx]);
+                play_seed(games->game_first, games->game_second, game_seeds[item % seeds_cnt], games->statistic);
+            }
+
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            progress_done += end - begin;
+            for (; progress_clear.size() < 50 * progress_done / items_cnt; progress_clear += " ") {
+                std::cerr << "."; std::cerr.flush();
+            }
+        });
+        std::cerr << "\r" << progress_clear << "\r";
+
+        for (size_t pairing_idx = 0; pairing_idx < pairings.size(); pairing_idx++) {
+            FullStatistic& statistic = result.statistic[pairings[pairing_idx]];
+            for (const auto& worker : workers) {
+                if (!worker[pairing_idx])
+                    continue;
+                statistic.merge(worker[pairing_idx]->statistic);
+                statistic.telemetry.merge(worker[pairing_idx]->game_first.get_telemetry());
+                statistic.telemetry.merge(worker[pairing_idx]->game_second.get_telemetry());
+            }
+        }
+    }
+    std::unique_ptr<PairingGames> make_pairing_games(const std::pair<size_t, size_t>& pairing) const {
+        std::unique_ptr<PairingGames> games(new PairingGames());
+        const GameHandDecisionFactory& first = decisions_[pairing.first].factory;
+        const GameHandDecisionFactory& second = decisions_[pairing.second].factory;
+        games->game_first.set_hand_decision(0, first());
+        games->game_first.set_hand_decision(1, second());
+        games->game_second.set_hand_decision(0, second());
+        games->game_second.set_hand_decision(1, first());
+        return games;
+    }
+
+    static Cache load_cache(const std::string& path) {
+        Cache cache;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || '#' == line[0])
+                continue;
+            std::istringstream stream(line);
+            std::string first, second;
+            size_t seeds_cnt = 0;
+            unsigned int seed = 0;
+            FullStatistic statistic;
+            stream >> first >> second >> seeds_cnt >> seed
+                >> statistic.first_decision_start.first_decision_win
+                >> statistic.first_decision_start.second_decision_win
+                >> statistic.first_decision_start.draw
+                >> statistic.second_decision_start.first_decision_win
+                >> statistic.second_decision_start.second_decision_win
+                >> statistic.second_decision_start.draw;
+            if (stream)
+                cache[cache_key(first, second, seeds_cnt, seed)] = statistic;
+        }
+        return cache;
+    }
+    // whole cache to a temporary file, then rename over the old one
+    static void save_cache(const std::string& path, const Cache& cache) {
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::trunc);
+            if (!file) {
+                std::cerr << "Unable to write tournament cache: " << tmp_path << std::endl;
+                return;
+            }
+            file << cache_header << std::endl;
+            for (const auto& item : cache) {
+                const FullStatistic& statistic = item.second;
+                file
+                    << std::get<0>(item.first) << " " << std::get<1>(item.first) << " "
+                    << std::get<2>(item.first) << " " << std::get<3>(item.first) << " "
+                    << statistic.first_decision_start.first_decision_win << " "
+                    << statistic.first_decision_start.second_decision_win << " "
+                    << statistic.first_decision_start.draw << " "
+                    << statistic.second_decision_start.first_decision_win << " "
+                    << statistic.second_decision_start.second_decision_win << " "
+                    << statistic.second_decision_start.draw
+                    << std::endl;
+            }
+        }
+#ifdef _WIN32
+        // rename does not replace existing file on Windows
+        std::remove(path.c_str());
+#endif
+        if (0 != std::rename(tmp_path.c_str(), path.c_str()))
+            std::cerr << "Unable to write tournament cache: " << path << std::endl;
+    }
+private:
+    std::unique_ptr<WorkStealingPool> own_pool_;
+    WorkStealingPool& pool_;
+    std::vector<DecisionInfo> decisions_;
+};
+
+template <int TestCount, typename... GameHandDecisionTypes>
+void calc_tournament(const std::string& cache_path = "", unsigned int seed = 1) {
+    Tournament tournament;
+    tournament.add_decisions<GameHandDecisionTypes...>();
+    std::cout << tournament.run(TestCount, seed, cache_path) << std::endl;
+}
+} // namespace durak_game
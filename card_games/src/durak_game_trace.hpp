@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// DURAK_GAME_TRACE=1 compiles the tracing spans in, without it
+// DURAK_GAME_TRACE_SPAN expands to nothing
+#ifndef DURAK_GAME_TRACE
+#define DURAK_GAME_TRACE 0
+#endif
+
+// TraceBuffer
+namespace durak_game {
+// complete span, names are string literals
+struct TraceEvent {
+    const char* name;
+    uint64_t begin_ns;
+    uint64_t duration_ns;
+};
+
+/*
+    Lock-free ring of spans of one thread: the owner thread pushes, a flushing
+    thread drains concurrently. When the ring is full new spans are dropped
+    and counted, so the flush never races with a rewritten slot.
+*/
+class TraceBuffer
+{
+public:
+    TraceBuffer(size_t thread_idx, size_t capacity_pow2, uint64_t generation)
+        : thread_idx_(thread_idx)
+        , generation_(generation)
+        , events_(capacity_pow2)
+        , mask_(capacity_pow2 - 1)
+        , head_(0)
+        , tail_(0)
+        , dropped_(0) {}
+
+    void push(const TraceEvent& event) {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) > mask_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events_[head & mask_] = event;
+        head_.store(head + 1, std::memory_order_release);
+    }
+    // only one thread may drain at a time
+    template <class Consumer>
+    void drain(Consumer consumer) {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const uint64_t head = head_.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; i++)
+            consumer(events_[i & mask_]);
+        tail_.store(head, std::memory_order_release);
+    }
+
+    size_t size() const {
+        return (size_t)(head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed));
+    }
+    size_t capacity() const { return events_.size(); }
+    size_t thread_idx() const { return thread_idx_; }
+    uint64_t generation() const { return generation_; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+private:
+    const size_t thread_idx_;
+    const uint64_t generation_;
+    std::vector<TraceEvent> events_;
+    const uint64_t mask_;
+    std::atomic<uint64_t> head_;
+    std::atomic<uint64_t> tail_;
+    std::atomic<uint64_t> dropped_;
+};
+} // namespace durak_game
+
+// Tracer
+namespace durak_game {
+/*
+    Process-wide writer of spans to a file in the Chrome Trace Event format,
+    the result opens in chrome://tracing or Perfetto.
+
+    start(path) begins a session and stop() ends it, both outside of traced
+    work; every thread gets own TraceBuffer on its first span. While the
+    session runs a flusher thread drains all buffers every flush_period and
+    appends their spans to the file as complete ("X") events, so neither the
+    rings of long runs overflow nor the memory grows with the run; flush()
+    does the same at once. A thread whose ring is half full flushes itself
+    and waits for a running flush, so a flusher starved of a core slows the
+    traced run instead of losing spans. stop() writes one timeline name per thread and the
+    count of dropped spans and closes the file.
+*/
+class Tracer
+{
+    using Clock = std::chrono::steady_clock;
+public:
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // false - the file can not be written, the session is not started
+    bool start(const std::string& path,
+               size_t events_per_thread = size_t(1) << 18,
+               std::chrono::milliseconds flush_period = std::chrono::milliseconds(10)) {
+        stop();
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.open(path, std::ios::trunc);
+        if (!file_)
+            return false;
+        file_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        events_cnt_ = 0;
+
+        size_t capacity = 1;
+        while (capacity < events_per_thread)
+            capacity <<= 1;
+        capacity_ = capacity;
+        buffers_.clear();
+        start_time_ = Clock::now();
+        generation_.fetch_add(1, std::memory_order_relaxed);
+        enabled_.store(true, std::memory_order_release);
+        flusher_running_ = true;
+        flusher_ = std::thread(&Tracer::flush_loop, this, flush_period);
+        return true;
+    }
+    // false - the file of the session was not written completely
+    bool stop() {
+        enabled_.store(false, std::memory_order_release);
+        stop_flusher();
+        flush();
+        const uint64_t dropped_cnt = dropped();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_.is_open())
+            return false;
+        for (const auto& buffer : buffers_) {
+            file_
+                << (0 < events_cnt_++ ? ",\n" : "")
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_idx()
+                << ",\"args\":{\"name\":\"thread " << buffer->thread_idx() << "\"}}";
+        }
+        file_ << "\n],\"otherData\":{\"dropped_spans\":" << dropped_cnt << "}}\n";
+        file_.close();
+        return !file_.fail();
+    }
+    bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flush_locked();
+    }
+    uint64_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t dropped = 0;
+        for (const auto& buffer : buffers_)
+            dropped += buffer->dropped();
+        return dropped;
+    }
+
+    uint64_t now_ns() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count();
+    }
+    void add(const TraceEvent& event) {
+        thread_local std::shared_ptr<TraceBuffer> buffer;
+        const uint64_t generation = generation_.load(std::memory_order_relaxed);
+        if (!buffer || buffer->generation() != generation) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer = std::make_shared<TraceBuffer>(buffers_.size(), capacity_, generation);
+            buffers_.push_back(buffer);
+        }
+        buffer->push(event);
+        if (buffer->capacity() / 2 < buffer->size())
+            flush();
+    }
+private:
+    Tracer()
+        : enabled_(false)
+        , generation_(0)
+        , capacity_(1)
+        , start_time_(Clock::now())
+        , events_cnt_(0)
+        , flusher_running_(false) {}
+    ~Tracer() {
+        stop_flusher();
+    }
+
+    // under mutex_
+    void flush_locked() {
+        if (!file_.is_open())
+            return;
+        for (const auto& buffer : buffers_) {
+            const size_t thread_idx = buffer->thread_idx();
+            buffer->drain([&](const TraceEvent& event) {
+                // microseconds with nanosecond digits, printed as integers: the flusher keeps up with the workers
+                char line[256];
+                const int line_size = std::snprintf(line, sizeof(line),
+                    "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+                    0 < events_cnt_++ ? ",\n" : "", event.name, thread_idx,
+                    (unsigned long long)(event.begin_ns / 1000), (unsigned)(event.begin_ns % 1000),
+                    (unsigned long long)(event.duration_ns / 1000), (unsigned)(event.duration_ns % 1000));
+                file_.write(line, std::min<int>(line_size, (int)sizeof(line) - 1));
+            });
+        }
+    }
+    void flush_loop(std::chrono::milliseconds flush_period) {
+        std::unique_lock<std::mutex> lock(flusher_mutex_);
+        while (!flusher_cv_.wait_for(lock, flush_period, [this]() { return !flusher_running_; }))
+            flush();
+    }
+    void stop_flusher() {
+        {
+            std::lock_guard<std::mutex> lock(flusher_mutex_);
+            flusher_running_ = false;
+        }
+        flusher_cv_.notify_all();
+        if (flusher_.joinable())
+            flusher_.join();
+    }
+private:
+    std::atomic<bool> enabled_;
+    std::atomic<uint64_t> generation_;
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    Clock::time_point start_time_;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers_; // buffers outlive their threads
+    std::ofstream file_;
+    uint64_t events_cnt_;
+
+    std::mutex flusher_mutex_;
+    std::condition_variable flusher_cv_;
+    bool flusher_running_;
+    std::thread flusher_;
+};
+
+// span from construction to destruction, recorded only while the tracer is enabled
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name)
+        : name_(name)
+        , begin_ns_(Tracer::instance().enabled() ? Tracer::instance().now_ns() : no_span) {}
+    ~TraceSpan() {
+        if (no_span == begin_ns_)
+            return;
+        Tracer& tracer = Tracer::instance();
+        tracer.add({ name_, begin_ns_, tracer.now_ns() - begin_ns_ });
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+private:
+    static constexpr uint64_t no_span = ~uint64_t(0);
+    const char* name_;
+    uint64_t begin_ns_;
+};
+} // namespace durak_game
+
+#define DURAK_GAME_TRACE_CONCAT_IMPL(a, b) a##b
+#define DURAK_GAME_TRACE_CONCAT(a, b) DURAK_GAME_TRACE_CONCAT_IMPL(a, b)
+#if DURAK_GAME_TRACE
+#define DURAK_GAME_TRACE_SPAN(name) ::durak_game::TraceSpan DURAK_GAME_TRACE_CONCAT(trace_span_, __LINE__)(name)
+#else
+#define DURAK_GAME_TRACE_SPAN(name) ((void)0)
+#endif
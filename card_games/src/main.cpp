@@ -1,14 +1,15 @@
 ﻿#include "cards_common.hpp"
-#include "cards_renderer.hpp"
 #include "durak_game.hpp"
+#include "durak_game_async_visualizer.hpp"
 #include "durak_game_decision_base.hpp"
 #include "durak_game_decision_less_card.hpp"
+#include "durak_game_renderer.hpp"
 #include "durak_game_statistic.hpp"
 
-#include <windows.h>
 #include <opencv2/highgui.hpp>
 
 #include <time.h>
+#include <atomic>
 #include <iostream>
 #include <chrono>
 #include <thread>
@@ -19,29 +20,34 @@ using namespace durak_game;
 namespace {
 class GameVisualizer
 {
+    // pause of the game thread, so the game is watchable
     class GameVisualizerStageEvent
         : public GameChangingStageEvent
     {
     public:
-        GameVisualizerStageEvent(GameVisualizer &owner)
-            : owner_(owner)
+        GameVisualizerStageEvent(std::chrono::milliseconds step_delay)
+            : step_delay_(step_delay)
         {
         }
         void stage_changing(Stage old_stage, Stage new_stage) override {
             if (Stage::NoneStage != new_stage)
-                owner_.render();
+                std::this_thread::sleep_for(step_delay_);
         }
     private:
-        GameVisualizer &owner_;
+        std::chrono::milliseconds step_delay_;
     };
 public:
-    GameVisualizer()
-        : durak_renderer_(
+    GameVisualizer(std::chrono::milliseconds step_delay = std::chrono::milliseconds(100))
+        : window_("table")
+        , visualizer_(
             "",
             "../res/cards_deck_sm.png",
             "../res/back_sm.png",
-            cv::Size(1000, 600)
+            cv::Size(1000, 600),
+            window_,
+            25.
         )
+        , step_delay_(step_delay)
     {}
     ~GameVisualizer() {}
 
@@ -54,23 +60,34 @@ public:
         std::cout << std::endl;
         std::cout << "Start hand: " << start_hand_idx << std::endl;
         std::cout << "Seed: " << seed << std::endl;
-        game_.add_stage_changing_event(std::unique_ptr< GameChangingStageEvent>(new GameVisualizerStageEvent(*this)));
+        game_.add_stage_changing_event(visualizer_.make_stage_event(game_));
+        if (0 < step_delay_.count())
+            game_.add_stage_changing_event(std::unique_ptr< GameChangingStageEvent>(new GameVisualizerStageEvent(step_delay_)));
+        visualizer_.start();
         game_.init(start_hand_idx, seed);
-        int lose_hand = game_.run();
+
+        // the game runs on its own thread, the window is shown and destroyed on this one
+        int lose_hand = -1;
+        std::atomic<bool> game_finished(false);
+        std::thread game_thread([&]() {
+            lose_hand = game_.run();
+            visualizer_.stop();
+            game_finished = true;
+        });
+        while (!game_finished)
+            window_.show(10);
+        game_thread.join();
+        window_.show(1);
+
         std::cout << "Lose hand: " << lose_hand << std::endl;
-        cv::destroyWindow("table");
+        std::cout << "Frames: " << visualizer_.get_rendered_frames() << ", dropped: " << visualizer_.get_dropped_snapshots() << std::endl;
+        window_.close();
     }
 private:
-    GameRenderer<GameRenderState<2>> durak_renderer_;
+    WindowSink window_;
+    AsyncGameVisualizer<2> visualizer_;
+    std::chrono::milliseconds step_delay_;
     Game<2> game_;
-
-    void render()
-    {
-        GameRenderState<2> game_state(game_);
-        const cv::Mat &table_img = durak_renderer_.render(game_state);
-        cv::imshow("table", table_img);
-        cv::waitKey(100);
-    }
 };
 }// namespace
 
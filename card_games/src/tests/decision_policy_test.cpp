@@ -0,0 +1,99 @@
+#include "durak_game.hpp"
+#include "durak_game_decision_policy.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+/*
+    Decision budget of GameHandDecisionPolicy reaches budget-aware policies
+    nested in the combinators.
+*/
+
+using namespace durak_game;
+
+namespace {
+int failures_cnt = 0;
+
+void check(bool condition, const char* what) {
+    if (condition)
+        return;
+    std::cerr << "FAILED: " << what << std::endl;
+    failures_cnt++;
+}
+
+// less card policies that count their calls and the calls with a limited budget
+struct BudgetCalls {
+    size_t calls = 0;
+    size_t limited_budget_calls = 0;
+};
+BudgetCalls attack_calls;
+BudgetCalls defend_calls;
+
+struct BudgetAttack {
+    AttackAction operator()(const GameStateConstPtr<2>& state) {
+        attack_calls.calls++;
+        return attack_step_opt_less_card<2>(state);
+    }
+    AttackAction operator()(const GameStateConstPtr<2>& state, const DecisionBudget& budget) {
+        if (budget.is_limited())
+            attack_calls.limited_budget_calls++;
+        return (*this)(state);
+    }
+};
+
+struct BudgetDefend {
+    DefendAction operator()(const GameStateConstPtr<2>& state) {
+        defend_calls.calls++;
+        return defend_step_opt_less_card<2>(state);
+    }
+    DefendAction operator()(const GameStateConstPtr<2>& state, const DecisionBudget& budget) {
+        if (budget.is_limited())
+            defend_calls.limited_budget_calls++;
+        return (*this)(state);
+    }
+};
+
+// partial policy without budget in front of the budget-aware one
+struct NoAttack {
+    std::optional<AttackAction> operator()(const GameStateConstPtr<2>& /*state*/) const {
+        return std::nullopt;
+    }
+};
+
+const char SolverIfCheapBudgetName[] = "SolverIfCheapBudget";
+// every position is cheap: SolverIfCheap always calls the budget-aware policy
+using SolverIfCheapBudget = GameHandDecisionPolicy<2, SolverIfCheapBudgetName,
+    policy::SolverIfCheap<36, policy::Fallback<NoAttack, BudgetAttack>, policy::AttackPass>,
+    policy::SolverIfCheap<36, policy::EpsilonMix<1, 1, policy::DefendTake, BudgetDefend>, policy::DefendTake>>;
+
+void test_budget_in_solver_if_cheap() {
+    static_assert(std::is_invocable_v<
+        policy::SolverIfCheap<36, BudgetAttack, policy::AttackPass>&,
+        const GameStateConstPtr<2>&, const DecisionBudget&>,
+        "SolverIfCheap takes the budget");
+
+    attack_calls = BudgetCalls();
+    defend_calls = BudgetCalls();
+    Game<2> game;
+    game.set_hand_decision(0, std::unique_ptr<GameHandDecision<2>>(new SolverIfCheapBudget()));
+    game.set_hand_decision(1, std::unique_ptr<GameHandDecision<2>>(new SolverIfCheapBudget()));
+    game.set_decision_time_limit(std::chrono::seconds(1));
+    for (unsigned int seed = 1; seed <= 20; seed++) {
+        game.init(-1, seed);
+        game.run();
+    }
+    check(0 < attack_calls.calls, "nested attack policy is called");
+    check(attack_calls.calls == attack_calls.limited_budget_calls, "nested attack policy gets the budget");
+    check(0 < defend_calls.calls, "nested defend policy is called");
+    check(defend_calls.calls == defend_calls.limited_budget_calls, "nested defend policy gets the budget");
+}
+} // namespace
+
+int main() {
+    test_budget_in_solver_if_cheap();
+    if (0 != failures_cnt)
+        return 1;
+    std::cout << "OK" << std::endl;
+    return 0;
+}
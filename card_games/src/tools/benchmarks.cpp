@@ -0,0 +1,537 @@
+#include "cards_common.hpp"
+#include "durak_game.hpp"
+#include "durak_game_decision_base.hpp"
+#include "durak_game_decision_less_card.hpp"
+#include "durak_game_decision_registry.hpp"
+#include "durak_game_statistic_shard.hpp"
+#if DURAK_GAME_RENDERER
+#include "durak_game_renderer.hpp"
+#endif
+
+#if BENCHMARKS_BANDITS
+#include "multi_arms_bandits.hpp"
+#endif
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+    Benchmarks of the card engine, the renderer and the bandit kernels.
+
+    benchmarks [--filter PREFIX] [--min-time SECONDS] [--output PATH]
+               [--baseline PATH [--tolerance FRACTION]] [--res DIR]
+
+    Every benchmark repeats batches of work for at least --min-time seconds and
+    reports work units per second. --filter keeps benchmarks with names
+    starting with PREFIX (game/, decision/, cards/, render/, bandit/).
+    --output saves the results as JSON, --baseline compares them with such a
+    file and returns 2 when any result is slower than the baseline by more
+    than --tolerance (default 0.1).
+*/
+
+using namespace durak_game;
+
+#ifndef BENCHMARKS_BUILD_TYPE
+#define BENCHMARKS_BUILD_TYPE ""
+#endif
+
+// Benchmark
+namespace {
+struct BenchmarkResult {
+    std::string name;
+    std::string unit;
+    double value = 0.;     // units per second
+    uint64_t units = 0;
+    double seconds = 0.;
+};
+
+struct BenchmarkOptions {
+    std::string filter;
+    double min_seconds = 1.;
+    std::string output_path;
+    std::string baseline_path;
+    double tolerance = 0.1;
+    std::string res_dir = "../res";
+};
+
+// batch() does some work and returns done units
+BenchmarkResult measure(const std::string& name, const std::string& unit, double min_seconds,
+                        const std::function<uint64_t()>& batch) {
+    using Clock = std::chrono::steady_clock;
+    batch(); // warm up
+
+    BenchmarkResult result;
+    result.name = name;
+    result.unit = unit;
+    const Clock::time_point start = Clock::now();
+    do {
+        result.units += batch();
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (result.seconds < min_seconds);
+    result.value = (double)result.units / result.seconds;
+    return result;
+}
+
+// copy of a game state at decision time, so decision functions can be called in a loop
+class StateSnapshot
+    : public GameState<2>
+{
+public:
+    explicit StateSnapshot(const GameState<2>& state)
+        : step_start_hand_idx_(state.get_step_start_hand_idx())
+        , stage_(state.get_current_stage())
+        , step_rest_append_cards_cnt_(state.get_step_rest_append_cards_cnt())
+        , step_attacker_hands_mask_(state.get_step_attacker_hands_mask())
+        , active_hand_idx_(state.get_active_hand_idx())
+        , attack_hand_idx_(state.get_attack_hand_idx())
+        , defend_hand_idx_(state.get_defend_hand_idx())
+        , trump_card_(state.get_trump_card())
+        , deck_size_(state.get_deck_size())
+        , rest_cards_size_(state.get_rest_cards_size())
+        , active_hand_(state.get_active_hand())
+        , garbage_(state.get_garbage())
+        , table_(state.get_table())
+        , rest_cards_(state.get_rest_cards())
+        , active_hand_mask_(state.get_active_hand_mask())
+        , table_mask_(state.get_table_mask())
+        , unseen_cards_mask_(state.get_unseen_cards_mask())
+        , rest_trumps_cnt_(state.get_rest_trumps_cnt())
+    {
+        for (size_t hand = 0; hand < 2; hand++) {
+            hands_size_[hand] = state.get_hands_size(hand);
+            known_hand_cards_mask_[hand] = state.get_known_hand_cards_mask(hand);
+        }
+    }
+
+    size_t get_step_start_hand_idx() const override { return step_start_hand_idx_; }
+    Stage get_current_stage() const override { return stage_; }
+    size_t get_step_rest_append_cards_cnt() const override { return step_rest_append_cards_cnt_; }
+    uint64_t get_step_attacker_hands_mask() const override { return step_attacker_hands_mask_; }
+
+    size_t get_active_hand_idx() const override { return active_hand_idx_; }
+    size_t get_attack_hand_idx() const override { return attack_hand_idx_; }
+    size_t get_defend_hand_idx() const override { return defend_hand_idx_; }
+
+    const cards_common::Card& get_trump_card() const override { return trump_card_; }
+
+    size_t get_deck_size() const override { return deck_size_; }
+    size_t get_hands_size(size_t hand_idx) const override { return hands_size_[hand_idx]; }
+    size_t get_rest_cards_size() const override { return rest_cards_size_; }
+
+    const cards_common::CardSet& get_active_hand() const override { return active_hand_; }
+    const cards_common::CardSet& get_garbage() const override { return garbage_; }
+    const cards_common::CardList& get_table() const override { return table_; }
+    cards_common::CardDeck get_rest_cards() const override { return rest_cards_; }
+
+    cards_common::CardMask get_active_hand_mask() const override { return active_hand_mask_; }
+    cards_common::CardMask get_table_mask() const override { return table_mask_; }
+    cards_common::CardMask get_known_hand_cards_mask(size_t hand_idx) const override { return known_hand_cards_mask_[hand_idx]; }
+    cards_common::CardMask get_unseen_cards_mask() const override { return unseen_cards_mask_; }
+    size_t get_rest_trumps_cnt() const override { return rest_trumps_cnt_; }
+private:
+    size_t step_start_hand_idx_;
+    Stage stage_;
+    size_t step_rest_append_cards_cnt_;
+    uint64_t step_attacker_hands_mask_;
+    size_t active_hand_idx_;
+    size_t attack_hand_idx_;
+    size_t defend_hand_idx_;
+    cards_common::Card trump_card_;
+    size_t deck_size_;
+    size_t hands_size_[2];
+    size_t rest_cards_size_;
+    cards_common::CardSet active_hand_;
+    cards_common::CardSet garbage_;
+    cards_common::CardList table_;
+    cards_common::CardDeck rest_cards_;
+    cards_common::CardMask active_hand_mask_;
+    cards_common::CardMask table_mask_;
+    cards_common::CardMask known_hand_cards_mask_[2];
+    cards_common::CardMask unseen_cards_mask_;
+    size_t rest_trumps_cnt_;
+};
+
+// less card decision that keeps snapshots of the states it was asked about
+class GameHandDecisionRecording
+    : public GameHandDecisionAttackDefendLessCard<2>
+{
+public:
+    GameHandDecisionRecording(std::vector<GameStateConstPtr<2>>& attack_states,
+                              std::vector<GameStateConstPtr<2>>& defend_states)
+        : attack_states_(attack_states)
+        , defend_states_(defend_states) {}
+
+    AttackAction attack_step(const GameStateConstPtr<2>& state) override {
+        attack_states_.push_back(std::make_shared<StateSnapshot>(*state));
+        return GameHandDecisionAttackDefendLessCard<2>::attack_step(state);
+    }
+    DefendAction defend_step(const GameStateConstPtr<2>& state) override {
+        defend_states_.push_back(std::make_shared<StateSnapshot>(*state));
+        return GameHandDecisionAttackDefendLessCard<2>::defend_step(state);
+    }
+private:
+    std::vector<GameStateConstPtr<2>>& attack_states_;
+    std::vector<GameStateConstPtr<2>>& defend_states_;
+};
+
+#if DURAK_GAME_RENDERER
+// render snapshots of the game on every stage change
+class RenderSnapshotRecording
+    : public GameChangingStageEvent
+{
+public:
+    RenderSnapshotRecording(const Game<2>& game, std::vector<GameRenderSnapshot<2>>& snapshots)
+        : game_(game)
+        , snapshots_(snapshots) {}
+
+    void stage_changing(Stage /*old_stage*/, Stage new_stage) override {
+        if (Stage::NoneStage != new_stage)
+            snapshots_.push_back(GameRenderSnapshot<2>(GameRenderState<2>(game_)));
+    }
+private:
+    const Game<2>& game_;
+    std::vector<GameRenderSnapshot<2>>& snapshots_;
+};
+#endif
+
+// keeps the result alive for the optimizer
+volatile uint64_t benchmark_sink = 0;
+} // namespace
+
+// benchmarks
+namespace {
+void game_benchmarks(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results) {
+    const DecisionRegistry& registry = DecisionRegistry::instance();
+    for (const std::string& name : registry.names()) {
+        Game<2> game;
+        game.set_hand_decision(0, registry.factory(name)());
+        game.set_hand_decision(1, registry.factory(name)());
+        unsigned int seed = 1;
+        results.push_back(measure("game/" + name, "games/s", options.min_seconds, [&]() {
+            for (size_t i = 0; i < 100; i++) {
+                game.init(-1, seed++);
+                benchmark_sink += (uint64_t)game.run();
+            }
+            return uint64_t(100);
+        }));
+    }
+}
+
+void decision_benchmarks(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results) {
+    std::vector<GameStateConstPtr<2>> attack_states;
+    std::vector<GameStateConstPtr<2>> defend_states;
+    Game<2> game;
+    game.set_hand_decision(0, std::unique_ptr<GameHandDecision<2>>(new GameHandDecisionRecording(attack_states, defend_states)));
+    game.set_hand_decision(1, std::unique_ptr<GameHandDecision<2>>(new GameHandDecisionRecording(attack_states, defend_states)));
+    for (unsigned int seed = 1; seed <= 200; seed++) {
+        game.init(-1, seed);
+        game.run();
+    }
+
+    results.push_back(measure("decision/attack_step_opt_less_card", "decisions/s", options.min_seconds, [&]() {
+        for (const auto& state : attack_states)
+            benchmark_sink += (uint64_t)attack_step_opt_less_card<2>(state).action_type;
+        return (uint64_t)attack_states.size();
+    }));
+    results.push_back(measure("decision/defend_step_opt_less_card", "decisions/s", options.min_seconds, [&]() {
+        for (const auto& state : defend_states)
+            benchmark_sink += (uint64_t)defend_step_opt_less_card<2>(state).action_type;
+        return (uint64_t)defend_states.size();
+    }));
+}
+
+void cards_benchmarks(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results) {
+    cards_common::CardDeck deck(cards_common::CardDeckType::CardDeck36);
+    std::vector<cards_common::Card> cards;
+    for (cards_common::CardDeck copy = deck; !copy.empty();)
+        cards.push_back(copy.pop_front());
+
+    results.push_back(measure("cards/CardSet_insert_erase", "ops/s", options.min_seconds, [&]() {
+        cards_common::CardSet set;
+        for (const auto& card : cards)
+            set.insert(card);
+        for (const auto& card : cards)
+            set.erase(card);
+        return uint64_t(2 * cards.size());
+    }));
+    cards_common::CardSet full;
+    for (const auto& card : cards)
+        full.insert(card);
+    results.push_back(measure("cards/CardSet_find", "ops/s", options.min_seconds, [&]() {
+        for (size_t repeat = 0; repeat < 100; repeat++) {
+            for (const auto& card : cards)
+                benchmark_sink += full.count(card);
+        }
+        return uint64_t(100 * cards.size());
+    }));
+    results.push_back(measure("cards/CardSet_has_suite", "ops/s", options.min_seconds, [&]() {
+        for (size_t repeat = 0; repeat < 100; repeat++)
+            benchmark_sink += full.has_suite(cards_common::CardsSuit::Clubs) ? 1 : 0;
+        return uint64_t(100);
+    }));
+    results.push_back(measure("cards/CardDeck_shuffle", "shuffles/s", options.min_seconds, [&]() {
+        for (unsigned int seed = 0; seed < 1000; seed++)
+            deck.shuffle(seed);
+        benchmark_sink += (uint64_t)deck.back().value_;
+        return uint64_t(1000);
+    }));
+}
+
+void render_benchmarks(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results) {
+#if !DURAK_GAME_RENDERER
+    (void)options;
+    (void)results;
+    std::cerr << "Skip render benchmarks: built without the renderer" << std::endl;
+#else
+    const std::string deck_path = options.res_dir + "/cards_deck_sm.png";
+    const std::string back_path = options.res_dir + "/back_sm.png";
+    if (!std::ifstream(deck_path) || !std::ifstream(back_path)) {
+        std::cerr << "Skip render benchmarks: no card images in " << options.res_dir << std::endl;
+        return;
+    }
+    Game<2> game;
+    game.set_hand_decision(0, std::unique_ptr<GameHandDecision<2>>(new GameHandDecisionAttackDefendLessCard<2>()));
+    game.set_hand_decision(1, std::unique_ptr<GameHandDecision<2>>(new GameHandDecisionAttackDefendLessCard<2>()));
+    game.init(0, 1);
+
+    // the same state every frame: without invalidate() every frame after the first draws nothing
+    GameRenderer<GameRenderState<2>> renderer("", deck_path, back_path, cv::Size(1000, 600));
+    const GameRenderState<2> state(game);
+    results.push_back(measure("render/TableRenderer_render", "frames/s", options.min_seconds, [&]() {
+        for (size_t i = 0; i < 10; i++) {
+            renderer.invalidate();
+            benchmark_sink += (uint64_t)renderer.render(state).rows;
+        }
+        return uint64_t(10);
+    }));
+
+    // recorded stage changes of a few games, frames redraw only the changed cards
+    std::vector<GameRenderSnapshot<2>> snapshots;
+    game.add_stage_changing_event(std::unique_ptr<GameChangingStageEvent>(new RenderSnapshotRecording(game, snapshots)));
+    for (unsigned int seed = 1; seed <= 10; seed++) {
+        game.init(-1, seed);
+        game.run();
+    }
+    GameRenderer<GameRenderSnapshotState<2>> snapshot_renderer("", deck_path, back_path, cv::Size(1000, 600));
+    results.push_back(measure("render/TableRenderer_render_incremental", "frames/s", options.min_seconds, [&]() {
+        for (const auto& snapshot : snapshots)
+            benchmark_sink += (uint64_t)snapshot_renderer.render(GameRenderSnapshotState<2>(snapshot)).rows;
+        return (uint64_t)snapshots.size();
+    }));
+#endif
+}
+
+void bandit_benchmarks(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results) {
+#if !BENCHMARKS_BANDITS
+    (void)options;
+    (void)results;
+    std::cerr << "Skip bandit benchmarks: built without OpenCV" << std::endl;
+#else
+    const size_t arms_cnt = 10;
+    const size_t steps_cnt = 1000;
+    std::vector<NormalReal::param_type> param_rewards;
+    {
+        RandomGen generator(3);
+        NormalReal rng(0.0, 1.0);
+        for (size_t arm = 0; arm < arms_cnt; arm++)
+            param_rewards.push_back(NormalReal::param_type(rng(generator), 1.0));
+    }
+    MultiArmsBanditModelPrecalc model(param_rewards, steps_cnt, 0);
+    model.get_reward(0, 0); // precalculation is not a part of the steps
+
+    int run = 0;
+    results.push_back(measure("bandit/EpsGreedy_step", "steps/s", options.min_seconds, [&]() {
+        MultiArmsBanditEpsGreedyStrategy strategy(arms_cnt, 0.1, ++run);
+        for (size_t i = 0; i < steps_cnt; i++) {
+            const size_t arm = strategy.getNextStepArm();
+            strategy.updateReward(arm, model.get_reward(arm, i));
+        }
+        return uint64_t(steps_cnt);
+    }));
+    results.push_back(measure("bandit/UCB_step", "steps/s", options.min_seconds, [&]() {
+        MultiArmsBanditUCBStrategy strategy(arms_cnt, 2., ++run);
+        for (size_t i = 0; i < steps_cnt; i++) {
+            const size_t arm = strategy.getNextStepArm();
+            strategy.updateReward(arm, model.get_reward(arm, i));
+        }
+        return uint64_t(steps_cnt);
+    }));
+
+    // arm selection of the tournament tree
+    const size_t many_arms_cnt = 4096;
+    std::vector<NormalReal::param_type> many_param_rewards;
+    {
+        RandomGen generator(3);
+        NormalReal rng(0.0, 1.0);
+        for (size_t arm = 0; arm < many_arms_cnt; arm++)
+            many_param_rewards.push_back(NormalReal::param_type(rng(generator), 1.0));
+    }
+    MultiArmsBanditModelPrecalc many_arms_model(many_param_rewards, 4 * many_arms_cnt, 0);
+    many_arms_model.get_reward(0, 0);
+    results.push_back(measure("bandit/UCB_step_4096_arms", "steps/s", options.min_seconds, [&]() {
+        MultiArmsBanditUCBStrategy strategy(many_arms_cnt, 2., ++run);
+        for (size_t i = 0; i < 4 * many_arms_cnt; i++) {
+            const size_t arm = strategy.getNextStepArm();
+            strategy.updateReward(arm, many_arms_model.get_reward(arm, i));
+        }
+        return uint64_t(4 * many_arms_cnt);
+    }));
+#endif
+}
+} // namespace
+
+// output
+namespace {
+bool starts_with(const std::string& text, const std::string& prefix) {
+    return 0 == text.compare(0, prefix.size(), prefix);
+}
+
+std::string compiler_name() {
+#if defined(_MSC_VER)
+    return "MSVC " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+std::string to_json(const std::vector<BenchmarkResult>& results) {
+    std::ostringstream stream;
+    stream << std::setprecision(6);
+    stream
+        << "{" << std::endl
+        << "  \"format\": \"durak_game_benchmarks\"," << std::endl
+        << "  \"version\": 1," << std::endl
+        << "  \"compiler\": " << json::quoted(compiler_name()) << "," << std::endl
+        << "  \"build_type\": " << json::quoted(BENCHMARKS_BUILD_TYPE) << "," << std::endl
+#ifdef NDEBUG
+        << "  \"ndebug\": true," << std::endl
+#else
+        << "  \"ndebug\": false," << std::endl
+#endif
+        << "  \"benchmarks\": [" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        stream
+            << "    { \"name\": " << json::quoted(result.name)
+            << ", \"unit\": " << json::quoted(result.unit)
+            << ", \"value\": " << result.value
+            << ", \"units\": " << result.units
+            << ", \"seconds\": " << result.seconds << " }"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    stream
+        << "  ]" << std::endl
+        << "}" << std::endl;
+    return stream.str();
+}
+
+bool load_baseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream file(path);
+    std::ostringstream text;
+    text << file.rdbuf();
+    json::Value root;
+    if (!file || !json::Reader(text.str()).parse(root))
+        return false;
+    const json::Value* benchmarks = root.find("benchmarks");
+    if (nullptr == benchmarks || json::Value::Array != benchmarks->type)
+        return false;
+    for (const auto& item : benchmarks->items) {
+        const json::Value* name = item.find("name");
+        const json::Value* value = item.find("value");
+        if (nullptr != name && nullptr != value && json::Value::Number == value->type)
+            baseline[name->text] = std::stod(value->text);
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, const char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if ("--filter" == arg && has_value)
+            options.filter = argv[++i];
+        else if ("--min-time" == arg && has_value)
+            options.min_seconds = std::stod(argv[++i]);
+        else if ("--output" == arg && has_value)
+            options.output_path = argv[++i];
+        else if ("--baseline" == arg && has_value)
+            options.baseline_path = argv[++i];
+        else if ("--tolerance" == arg && has_value)
+            options.tolerance = std::stod(argv[++i]);
+        else if ("--res" == arg && has_value)
+            options.res_dir = argv[++i];
+        else {
+            std::cout
+                << "Usage: " << argv[0]
+                << " [--filter PREFIX] [--min-time SECONDS] [--output PATH] [--baseline PATH [--tolerance FRACTION]] [--res DIR]"
+                << std::endl;
+            return 1;
+        }
+    }
+
+    const std::vector<std::pair<std::string, std::function<void(const BenchmarkOptions&, std::vector<BenchmarkResult>&)>>> groups = {
+        { "game/", game_benchmarks },
+        { "decision/", decision_benchmarks },
+        { "cards/", cards_benchmarks },
+        { "render/", render_benchmarks },
+        { "bandit/", bandit_benchmarks },
+    };
+    std::vector<BenchmarkResult> results;
+    for (const auto& group : groups) {
+        // the filter is a prefix of benchmark names
+        if (!starts_with(options.filter, group.first) && !starts_with(group.first, options.filter))
+            continue;
+        std::vector<BenchmarkResult> group_results;
+        group.second(options, group_results);
+        for (auto& result : group_results) {
+            if (starts_with(result.name, options.filter))
+                results.push_back(result);
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!options.baseline_path.empty() && !load_baseline(options.baseline_path, baseline)) {
+        std::cerr << "Unable to read baseline: " << options.baseline_path << std::endl;
+        return 1;
+    }
+    size_t regressions_cnt = 0;
+    for (const auto& result : results) {
+        std::cout << std::left << std::setw(52) << result.name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(1) << result.value << " " << result.unit;
+        auto it = baseline.find(result.name);
+        if (baseline.end() != it && 0. < it->second) {
+            const double ratio = result.value / it->second;
+            const bool regression = ratio < 1. - options.tolerance;
+            regressions_cnt += regression ? 1 : 0;
+            std::cout << "  x" << std::setprecision(3) << ratio << (regression ? "  REGRESSION" : "");
+        }
+        std::cout << std::endl;
+    }
+
+    if (!options.output_path.empty()) {
+        std::ofstream file(options.output_path, std::ios::trunc);
+        file << to_json(results);
+        if (!file) {
+            std::cerr << "Unable to write results: " << options.output_path << std::endl;
+            return 1;
+        }
+    }
+    if (0 < regressions_cnt) {
+        std::cout << regressions_cnt << " benchmarks are slower than the baseline" << std::endl;
+        return 2;
+    }
+    return 0;
+}
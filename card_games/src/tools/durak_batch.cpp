@@ -0,0 +1,373 @@
+#include "durak_game.hpp"
+#include "durak_game_decision_registry.hpp"
+#include "durak_game_sequential_test.hpp"
+#include "durak_game_statistic.hpp"
+#include "durak_game_statistic_checkpoint.hpp"
+#include "durak_game_statistic_shard.hpp"
+#include "durak_game_tournament.hpp"
+#include "durak_game_trace.hpp"
+
+// DURAK_GAME_RENDERER=1 - built with the renderer target, --monitor and --monitor-window are available
+#ifndef DURAK_GAME_RENDERER
+#define DURAK_GAME_RENDERER 0
+#endif
+#if DURAK_GAME_RENDERER
+#include "durak_game_async_visualizer.hpp"
+#include "durak_game_mosaic_monitor.hpp"
+#endif
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Headless batch runner of statistics.
+
+    durak_batch [options] <decision> <decision> [<decision> ...]
+
+    Two decisions - statistic of the pair (DecisionStatistician), more decisions -
+    round-robin tournament. Decisions are names from DecisionRegistry.
+*/
+
+using namespace durak_game;
+
+namespace {
+struct BatchOptions {
+    std::vector<std::string> decisions;
+    size_t games_cnt = 80000;       // per pairing, 4 games per seed
+    size_t threads_cnt = 0;         // 0 - all cores
+    unsigned int seed = 1;
+    bool adaptive = false;
+    bool antithetic = false;
+    bool latency = true;
+    bool list = false;
+    std::string output_path;
+    std::string metrics_path;
+    std::string trace_path;
+    std::string monitor_path;
+    bool monitor_window = false;
+    size_t monitor_tiles_cnt = 4;
+    std::string cache_path;
+    std::string book_path;
+    size_t shard_idx = 0;           // seeds of shard shard_idx from shards_cnt equal parts
+    size_t shards_cnt = 1;
+    std::string shard_path;
+    std::string checkpoint_path;
+    size_t checkpoint_seeds_cnt = 10000;
+    bool resume = false;
+};
+
+void print_usage(const char* program) {
+    std::cout
+        << "Usage: " << program << " [options] <decision> <decision> [<decision> ...]" << std::endl
+        << "  --list           registered decisions" << std::endl
+        << "  --games N        games per pairing, rounded up to whole seeds (default 80000)" << std::endl
+        << "  --threads N      worker threads, 0 - all cores (default 0)" << std::endl
+        << "  --seed N         seed of the game seeds (default 1)" << std::endl
+        << "  --adaptive       stop a pair early by the sequential test, --games is the maximum" << std::endl
+        << "  --antithetic     play every seed of the pair on the antithetic deal too, 8 games per seed" << std::endl
+        << "  --no-latency     do not measure decision latency of the pair" << std::endl
+        << "  --output PATH    write the report to the file too" << std::endl
+        << "  --metrics PATH   write results and game telemetry in the Prometheus text format" << std::endl
+        << "  --trace PATH     write tracing spans as Chrome Trace Event JSON (DURAK_GAME_TRACE builds)" << std::endl
+        << "  --monitor PATH   keep a mosaic of live games of the pair in the image PATH (renderer builds)" << std::endl
+        << "  --monitor-window show the mosaic of live games of the pair in a window (renderer builds)" << std::endl
+        << "  --monitor-tiles N    games in the mosaic (default 4)" << std::endl
+        << "  --cache PATH     tournament cache of finished pairings" << std::endl
+        << "  --book PATH      register OpeningBook(<decision>) decisions with the opening book PATH" << std::endl
+        << "  --shard I/N      play only the I-th of N equal seed ranges of the pair (I from 0)" << std::endl
+        << "  --shard-output PATH  save the pair statistic as a mergeable JSON shard" << std::endl
+        << "  --checkpoint PATH    save the pair progress to PATH every --checkpoint-every seeds" << std::endl
+        << "  --checkpoint-every N seeds between checkpoints (default 10000)" << std::endl
+        << "  --resume         continue the run from --checkpoint" << std::endl;
+}
+
+bool parse_options(int argc, const char** argv, BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (argc <= i + 1)
+                throw std::invalid_argument("Missing value of " + arg);
+            return argv[++i];
+        };
+        if ("--list" == arg)
+            options.list = true;
+        else if ("--games" == arg)
+            options.games_cnt = std::stoul(value());
+        else if ("--threads" == arg)
+            options.threads_cnt = std::stoul(value());
+        else if ("--seed" == arg)
+            options.seed = (unsigned int)std::stoul(value());
+        else if ("--adaptive" == arg)
+            options.adaptive = true;
+        else if ("--antithetic" == arg)
+            options.antithetic = true;
+        else if ("--no-latency" == arg)
+            options.latency = false;
+        else if ("--output" == arg)
+            options.output_path = value();
+        else if ("--metrics" == arg)
+            options.metrics_path = value();
+        else if ("--trace" == arg)
+            options.trace_path = value();
+        else if ("--monitor" == arg)
+            options.monitor_path = value();
+        else if ("--monitor-window" == arg)
+            options.monitor_window = true;
+        else if ("--monitor-tiles" == arg)
+            options.monitor_tiles_cnt = std::stoul(value());
+        else if ("--cache" == arg)
+            options.cache_path = value();
+        else if ("--book" == arg)
+            options.book_path = value();
+        else if ("--shard" == arg) {
+            const std::string shard = value();
+            const size_t slash = shard.find('/');
+            if (std::string::npos == slash)
+                throw std::invalid_argument("Invalid --shard " + shard);
+            options.shard_idx = std::stoul(shard.substr(0, slash));
+            options.shards_cnt = std::stoul(shard.substr(slash + 1));
+            if (0 == options.shards_cnt || options.shards_cnt <= options.shard_idx)
+                throw std::invalid_argument("Invalid --shard " + shard);
+        }
+        else if ("--shard-output" == arg)
+            options.shard_path = value();
+        else if ("--checkpoint" == arg)
+            options.checkpoint_path = value();
+        else if ("--checkpoint-every" == arg)
+            options.checkpoint_seeds_cnt = std::stoul(value());
+        else if ("--resume" == arg)
+            options.resume = true;
+        else if (0 == arg.compare(0, 2, "--"))
+            throw std::invalid_argument("Unknown option " + arg);
+        else
+            options.decisions.push_back(arg);
+    }
+    if (2 < options.decisions.size() && (options.adaptive || options.antithetic || !options.latency))
+        throw std::invalid_argument("--adaptive, --antithetic and --no-latency need exactly two decisions");
+    if (1 < options.shards_cnt && 2 != options.decisions.size())
+        throw std::invalid_argument("--shard needs exactly two decisions");
+    if (!options.shard_path.empty() && (2 != options.decisions.size() || options.adaptive))
+        throw std::invalid_argument("--shard-output needs exactly two decisions without --adaptive");
+    if (1 < options.shards_cnt && options.adaptive)
+        throw std::invalid_argument("--shard can not be used with --adaptive");
+    if (!options.trace_path.empty() && !DURAK_GAME_TRACE)
+        throw std::invalid_argument("--trace needs a build with DURAK_GAME_TRACE");
+    const bool monitor = !options.monitor_path.empty() || options.monitor_window;
+    if (monitor && !DURAK_GAME_RENDERER)
+        throw std::invalid_argument("--monitor and --monitor-window need a build with the renderer (DURAK_BATCH_MONITOR)");
+    if (monitor && (2 != options.decisions.size() || 0 == options.monitor_tiles_cnt))
+        throw std::invalid_argument("--monitor and --monitor-window need exactly two decisions and at least one tile");
+    if (options.resume && options.checkpoint_path.empty())
+        throw std::invalid_argument("--resume needs --checkpoint");
+    if (!options.checkpoint_path.empty()
+        && (2 != options.decisions.size() || options.adaptive || 1 < options.shards_cnt || !options.shard_path.empty()))
+        throw std::invalid_argument("--checkpoint needs exactly two decisions without --adaptive and --shard");
+    return options.list || 2 <= options.decisions.size();
+}
+
+void print_registry(const DecisionRegistry& registry) {
+    std::cout << "Decisions:" << std::endl;
+    for (const auto& name : registry.names())
+        std::cout << "  " << name << std::endl;
+}
+
+#if DURAK_GAME_RENDERER
+using MonitorWindow = WindowSink;
+
+// mosaic of live games of the pair to the image and/or the window, nullptr without both
+std::unique_ptr<MosaicMonitor> start_monitor(
+    const BatchOptions& options, DecisionStatistician& statistician, const MonitorWindow* window)
+{
+    if (options.monitor_path.empty() && !window)
+        return nullptr;
+    MosaicMonitor::FrameSink sink;
+    if (!window)
+        sink = ImageFileSink(options.monitor_path);
+    else if (options.monitor_path.empty())
+        sink = *window;
+    else {
+        const ImageFileSink file_sink(options.monitor_path);
+        const MonitorWindow window_sink = *window;
+        sink = [file_sink, window_sink](const cv::Mat& frame) {
+            file_sink(frame);
+            window_sink(frame);
+        };
+    }
+    LiveGameSampler::Params sampler_params;
+    sampler_params.tiles_cnt = options.monitor_tiles_cnt;
+    auto sampler = std::make_shared<LiveGameSampler>(sampler_params);
+    statistician.attach_sampler(*sampler);
+    std::unique_ptr<MosaicMonitor> monitor(new MosaicMonitor(sampler, MosaicMonitor::Params(), sink));
+    monitor->start();
+    return monitor;
+}
+#else
+struct MonitorWindow {
+    explicit MonitorWindow(const std::string& /*window_name*/) {}
+    void show(int /*delay_ms*/) {}
+    void close() {}
+};
+struct NoMonitor {
+    void stop() {}
+};
+std::unique_ptr<NoMonitor> start_monitor(
+    const BatchOptions& /*options*/, DecisionStatistician& /*statistician*/, const MonitorWindow* /*window*/)
+{
+    return nullptr;
+}
+#endif
+
+// window - mosaic window of --monitor-window, nullptr without it
+std::string run_batch(
+    const BatchOptions& options, const DecisionRegistry& registry, std::ostream& metrics, const MonitorWindow* window)
+{
+    const size_t games_per_seed = FullStatistic::games_per_seed * (options.antithetic ? 2 : 1);
+    const size_t seeds_cnt = (options.games_cnt + games_per_seed - 1) / games_per_seed;
+    std::ostringstream report;
+    if (2 == options.decisions.size()) {
+        const std::string& first = options.decisions[0];
+        const std::string& second = options.decisions[1];
+        std::unique_ptr<DecisionStatistician> statistician =
+            registry.make_statistician(first, second, options.threads_cnt);
+        statistician->set_decision_latency_enabled(options.latency);
+        statistician->set_antithetic_deals(options.antithetic);
+        const auto monitor = start_monitor(options, *statistician, window);
+        if (!options.checkpoint_path.empty()) {
+            CheckpointedRunParams params;
+            params.seeds_total = seeds_cnt;
+            params.seed = options.seed;
+            params.antithetic_deals = options.antithetic;
+            params.checkpoint_path = options.checkpoint_path;
+            params.checkpoint_seeds_cnt = options.checkpoint_seeds_cnt;
+            params.resume = options.resume;
+            const StatisticShard shard = run_with_checkpoints(*statistician, params);
+            write_metrics(metrics, shard.statistic);
+            report << shard;
+        } else if (options.adaptive) {
+            const FullStatistic statistic = statistician->run_adaptive((int)seeds_cnt, SequentialTestParams(), options.seed);
+            write_metrics(metrics, statistic);
+            report << statistic;
+            report << "Seeds: " << seeds_cnt << " from seed " << options.seed;
+        } else {
+            StatisticShard shard;
+            shard.seed = options.seed;
+            shard.seeds_total = seeds_cnt;
+            shard.antithetic_deals = options.antithetic;
+            shard.seed_ranges.push_back({
+                seeds_cnt * options.shard_idx / options.shards_cnt,
+                seeds_cnt * (options.shard_idx + 1) / options.shards_cnt });
+            shard.statistic = statistician->run_range(
+                seeds_cnt, options.seed, shard.seed_ranges[0].first, shard.seed_ranges[0].second);
+            if (!options.shard_path.empty() && !shard.save(options.shard_path))
+                throw std::runtime_error("Unable to write shard: " + options.shard_path);
+            write_metrics(metrics, shard.statistic);
+            report << shard.statistic;
+            report
+                << "Seeds: [" << shard.seed_ranges[0].first << ", " << shard.seed_ranges[0].second << ") of "
+                << seeds_cnt << " from seed " << options.seed;
+        }
+        report << std::endl;
+        if (monitor)
+            monitor->stop();
+    } else {
+        Tournament tournament(options.threads_cnt);
+        for (const auto& name : options.decisions)
+            tournament.add_decision(name, registry.factory(name));
+        const TournamentResult result = tournament.run(seeds_cnt, options.seed, options.cache_path);
+        for (const auto& pairing : result.statistic)
+            write_metrics(metrics, pairing.second);
+        report << result;
+    }
+    return report.str();
+}
+
+// HighGUI needs the main thread: the batch runs on a worker thread while the calling thread shows the window
+std::string run_batch_in_window(const BatchOptions& options, const DecisionRegistry& registry, std::ostream& metrics) {
+    MonitorWindow window("durak_batch");
+    std::atomic<bool> finished(false);
+    std::exception_ptr error;
+    std::string report;
+    std::thread batch([&]() {
+        try {
+            report = run_batch(options, registry, metrics, &window);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        finished = true;
+    });
+    while (!finished)
+        window.show(30);
+    batch.join();
+    window.close();
+    if (error)
+        std::rethrow_exception(error);
+    return report;
+}
+} // namespace
+
+int main(int argc, const char** argv) {
+    BatchOptions options;
+    try {
+        if (!parse_options(argc, argv, options)) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        DecisionRegistry& registry = DecisionRegistry::instance();
+        if (!options.book_path.empty())
+            registry.add_opening_book(options.book_path);
+        if (options.list) {
+            print_registry(registry);
+            return 0;
+        }
+        // unknown name throws before any game is played
+        for (const auto& name : options.decisions)
+            registry.factory(name);
+
+        std::ostringstream metrics;
+        if (!options.trace_path.empty() && !Tracer::instance().start(options.trace_path)) {
+            std::cerr << "Unable to write trace: " << options.trace_path << std::endl;
+            return 1;
+        }
+        const std::string report = options.monitor_window
+            ? run_batch_in_window(options, registry, metrics)
+            : run_batch(options, registry, metrics, nullptr);
+        if (!options.trace_path.empty()) {
+            if (!Tracer::instance().stop()) {
+                std::cerr << "Unable to write trace: " << options.trace_path << std::endl;
+                return 1;
+            }
+            if (0 < Tracer::instance().dropped())
+                std::cerr << "Trace buffers overflowed, dropped spans: " << Tracer::instance().dropped() << std::endl;
+        }
+        std::cout << report << std::endl;
+        if (!options.output_path.empty()) {
+            std::ofstream file(options.output_path, std::ios::trunc);
+            file << report;
+            if (!file) {
+                std::cerr << "Unable to write report: " << options.output_path << std::endl;
+                return 1;
+            }
+        }
+        if (!options.metrics_path.empty()) {
+            std::ofstream file(options.metrics_path, std::ios::trunc);
+            file << metrics.str();
+            if (!file) {
+                std::cerr << "Unable to write metrics: " << options.metrics_path << std::endl;
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "durak_game_statistic_shard.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+    Merge of statistic shards written by durak_batch --shard-output.
+
+    durak_merge [--output PATH] <shard.json> [<shard.json> ...]
+
+    All shards must be of the same run and have disjoint seed ranges. Prints
+    the merged statistic and saves it as a shard when --output is given.
+*/
+
+using namespace durak_game;
+
+int main(int argc, const char** argv) {
+    std::string output_path;
+    std::vector<std::string> shard_paths;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if ("--output" == arg && i + 1 < argc)
+            output_path = argv[++i];
+        else
+            shard_paths.push_back(arg);
+    }
+    if (shard_paths.empty()) {
+        std::cout << "Usage: " << argv[0] << " [--output PATH] <shard.json> [<shard.json> ...]" << std::endl;
+        return 1;
+    }
+
+    StatisticShard merged;
+    for (size_t i = 0; i < shard_paths.size(); i++) {
+        StatisticShard shard;
+        std::string error;
+        if (!shard.load(shard_paths[i], error)) {
+            std::cerr << shard_paths[i] << ": " << error << std::endl;
+            return 1;
+        }
+        if (0 == i)
+            merged = shard;
+        else if (!merged.merge(shard, error)) {
+            std::cerr << shard_paths[i] << ": " << error << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << merged;
+    if (!merged.complete())
+        std::cout << "Warning: " << merged.seeds_total - merged.seeds_cnt() << " seeds are not covered" << std::endl;
+    if (!output_path.empty() && !merged.save(output_path)) {
+        std::cerr << "Unable to write shard: " << output_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "durak_game_decision_registry.hpp"
+#include "durak_game_replay_renderer.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+/*
+    Headless renderer of recorded games.
+
+    durak_render [options] (--video PATH | --frames DIR) <games.txt>
+
+    games.txt lists games as "<hand 0 decision> <hand 1 decision> <seed>
+    [<start hand> [antithetic]]", decisions are names from DecisionRegistry.
+*/
+
+using namespace durak_game;
+
+namespace {
+struct RenderOptions {
+    std::string games_path;
+    std::string video_path;
+    std::string frames_dir;
+    size_t threads_cnt = 0;
+    double fps = 10.;
+    ReplayRenderer::Params params;
+};
+
+void print_usage(const char* program) {
+    std::cout
+        << "Usage: " << program << " [options] (--video PATH | --frames DIR) <games.txt>" << std::endl
+        << "  --video PATH     write frames to a video file (MJPG)" << std::endl
+        << "  --frames DIR     write frames as DIR/frame_000000.png, ..." << std::endl
+        << "  --fps F          video frame rate (default 10)" << std::endl
+        << "  --threads N      worker threads, 0 - all cores (default 0)" << std::endl
+        << "  --res DIR        directory of card images (default ../res)" << std::endl
+        << "  --size WxH       table size (default 1000x600)" << std::endl
+        << "  --end-frames N   frames of the final table of every game (default 1)" << std::endl
+        << "  --in-flight N    games with frames in memory at a time (default 8)" << std::endl;
+}
+
+bool parse_options(int argc, const char** argv, RenderOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (argc <= i + 1)
+                throw std::invalid_argument("Missing value of " + arg);
+            return argv[++i];
+        };
+        if ("--video" == arg)
+            options.video_path = value();
+        else if ("--frames" == arg)
+            options.frames_dir = value();
+        else if ("--fps" == arg)
+            options.fps = std::stod(value());
+        else if ("--threads" == arg)
+            options.threads_cnt = std::stoul(value());
+        else if ("--res" == arg) {
+            const std::string res_dir = value();
+            options.params.cards_deck_img_path = res_dir + "/cards_deck_sm.png";
+            options.params.cards_back_img_path = res_dir + "/back_sm.png";
+        }
+        else if ("--size" == arg) {
+            const std::string size = value();
+            const size_t x = size.find('x');
+            if (std::string::npos == x)
+                throw std::invalid_argument("Invalid --size " + size);
+            options.params.table_size = cv::Size(std::stoi(size.substr(0, x)), std::stoi(size.substr(x + 1)));
+        }
+        else if ("--end-frames" == arg)
+            options.params.end_frames_cnt = std::stoul(value());
+        else if ("--in-flight" == arg)
+            options.params.games_in_flight = std::stoul(value());
+        else if (0 == arg.compare(0, 2, "--"))
+            throw std::invalid_argument("Unknown option " + arg);
+        else
+            options.games_path = arg;
+    }
+    return !options.games_path.empty() && (options.video_path.empty() != options.frames_dir.empty());
+}
+} // namespace
+
+int main(int argc, const char** argv) {
+    RenderOptions options;
+    try {
+        if (!parse_options(argc, argv, options)) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        const std::vector<GameReplay> replays = load_game_replays(options.games_path);
+        ReplayRenderer renderer(DecisionRegistry::instance(), options.params, options.threads_cnt);
+
+        ReplayRenderer::FrameSink sink;
+        if (!options.video_path.empty())
+            sink = VideoSink(options.video_path, options.fps, options.params.table_size);
+        else
+            sink = ImageSequenceSink(options.frames_dir);
+
+        const auto start = std::chrono::steady_clock::now();
+        const size_t frames_cnt = renderer.render(replays, sink);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout
+            << replays.size() << " games, " << frames_cnt << " frames in " << seconds << " s ("
+            << (0. < seconds ? (double)frames_cnt / seconds : 0.) << " frames/s)" << std::endl;
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
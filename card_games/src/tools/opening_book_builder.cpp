@@ -0,0 +1,240 @@
+#include "cards_common.hpp"
+#include "durak_game.hpp"
+#include "durak_game_decision_base.hpp"
+#include "durak_game_decision_less_card.hpp"
+#include "durak_game_opening_book.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Offline builder of the opening book.
+
+    opening_book_builder <book_path> [games_per_card = 200] [threads = all cores] [seed = 1]
+
+    For every canonical opening hand (trump suit in slot 0) and every first
+    attack card the position is played games_per_card times with random rest
+    of the deal and GameHandDecisionAttackDefendLessCard for both hands. The
+    same deals are used for all cards of the hand, the best card goes to book.
+*/
+
+using namespace durak_game;
+
+// OpeningState
+namespace {
+class OpeningState
+    : public GameState<2>
+{
+public:
+    OpeningState(const cards_common::CardSet& hand, const cards_common::Card& trump_card)
+        : hand_(hand)
+        , hand_mask_(cards_common::cards_mask(hand))
+        , trump_card_(trump_card)
+    {
+        const cards_common::CardMask rest =
+            cards_common::deck_mask(cards_common::CardDeckType::CardDeck36)
+            & ~hand_mask_ & ~cards_common::card_mask(trump_card);
+        for (cards_common::CardMask mask = rest; 0 != mask; mask &= mask - 1)
+            rest_cards_.push_back(cards_common::card_from_index(cards_common::mask_first_card_index(mask)));
+        rest_cards_.push_back(trump_card);
+    }
+
+    size_t get_step_start_hand_idx() const override { return 0; }
+    Stage get_current_stage() const override { return Stage::AttackStage; }
+    size_t get_step_rest_append_cards_cnt() const override { return 0; }
+    uint64_t get_step_attacker_hands_mask() const override { return 0; }
+
+    size_t get_active_hand_idx() const override { return 0; }
+    size_t get_attack_hand_idx() const override { return 0; }
+    size_t get_defend_hand_idx() const override { return 1; }
+
+    const cards_common::Card& get_trump_card() const override { return trump_card_; }
+
+    size_t get_deck_size() const override {
+        return cards_common::get_deck_size(cards_common::CardDeckType::CardDeck36) - 2 * hands_start_amount;
+    }
+    size_t get_hands_size(size_t /*hand_idx*/) const override { return hands_start_amount; }
+    size_t get_rest_cards_size() const override { return rest_cards_.size(); }
+
+    const cards_common::CardSet& get_active_hand() const override { return hand_; }
+    const cards_common::CardSet& get_garbage() const override { return garbage_; }
+    const cards_common::CardList& get_table() const override { return table_; }
+    cards_common::CardDeck get_rest_cards() const override { return rest_cards_; }
+
+    cards_common::CardMask get_active_hand_mask() const override { return hand_mask_; }
+    cards_common::CardMask get_table_mask() const override { return 0; }
+    cards_common::CardMask get_known_hand_cards_mask(size_t /*hand_idx*/) const override { return 0; }
+    cards_common::CardMask get_unseen_cards_mask() const override {
+        return cards_common::deck_mask(cards_common::CardDeckType::CardDeck36)
+            & ~hand_mask_ & ~cards_common::card_mask(trump_card_);
+    }
+    size_t get_rest_trumps_cnt() const override {
+        return cards_common::mask_cards_count(
+            cards_common::suit_mask(trump_card_.suit_)
+            & cards_common::deck_mask(cards_common::CardDeckType::CardDeck36)
+            & ~hand_mask_);
+    }
+private:
+    cards_common::CardSet hand_;
+    cards_common::CardMask hand_mask_;
+    cards_common::Card trump_card_;
+    cards_common::CardDeck rest_cards_;
+    cards_common::CardSet garbage_;
+    cards_common::CardList table_;
+};
+
+// first attack by the given card, then the less card decision
+class GameHandDecisionForcedFirstAttack
+    : public GameHandDecisionAttackDefendLessCard<2>
+{
+public:
+    void set_first_attack(const cards_common::Card& card) {
+        first_attack_ = card;
+    }
+    void game_reset(const GameStateConstPtr<2>& state) override {
+        GameHandDecisionAttackDefendLessCard<2>::game_reset(state);
+        first_attack_done_ = false;
+    }
+    AttackAction attack_step(const GameStateConstPtr<2>& state) override {
+        if (!first_attack_done_) {
+            first_attack_done_ = true;
+            return { AttackActionType::Attack, first_attack_ };
+        }
+        return GameHandDecisionAttackDefendLessCard<2>::attack_step(state);
+    }
+private:
+    cards_common::Card first_attack_;
+    bool first_attack_done_ = false;
+};
+
+// canonical key -> cards with trump suit Spades, slot i -> suit Spades + i
+cards_common::CardSet canonical_hand(uint64_t key) {
+    cards_common::CardSet hand;
+    opening_book::SuitMapping mapping;
+    for (size_t slot = 0; slot < 4; slot++)
+        mapping.slot_suit[slot] = (cards_common::CardsSuit)((size_t)cards_common::CardsSuit::Spades + slot);
+    for (; 0 != key; key &= key - 1)
+        hand.insert(opening_book::canonical_card(cards_common::mask_first_card_index(key), mapping));
+    return hand;
+}
+
+std::vector<uint64_t> canonical_keys() {
+    std::vector<uint64_t> keys;
+    const uint64_t limit = uint64_t(1) << (4 * opening_book::suit_values_cnt);
+    // all 6-card subsets of 36 cards in increasing order (Gosper's hack)
+    for (uint64_t key = (uint64_t(1) << opening_book::opening_hand_size) - 1; key < limit;) {
+        const cards_common::CardSet hand = canonical_hand(key);
+        if (key == opening_book::canonical_key(cards_common::cards_mask(hand), cards_common::CardsSuit::Spades))
+            keys.push_back(key);
+
+        const uint64_t lowest = key & (~key + 1);
+        const uint64_t ripple = key + lowest;
+        key = (((ripple ^ key) >> 2) / lowest) | ripple;
+    }
+    return keys;
+}
+
+// canonical index of the best first attack card
+size_t evaluate_position(uint64_t key, size_t games_per_card, unsigned int seed,
+                         Game<2>& game, GameHandDecisionForcedFirstAttack& attacker) {
+    const cards_common::CardSet hand = canonical_hand(key);
+    const cards_common::CardMask hand_mask = cards_common::cards_mask(hand);
+    const cards_common::CardMask trumps =
+        cards_common::suit_mask(cards_common::CardsSuit::Spades)
+        & cards_common::deck_mask(cards_common::CardDeckType::CardDeck36)
+        & ~hand_mask;
+
+    std::mt19937 generator(seed ^ (unsigned int)opening_book::hash_key(key));
+    std::vector<std::pair<cards_common::Card, unsigned int>> deals(games_per_card);
+    for (auto& deal : deals) {
+        deal.first = pick_random_card(trumps, generator);
+        deal.second = generator();
+    }
+
+    opening_book::SuitMapping mapping;
+    opening_book::canonical_key(hand_mask, cards_common::CardsSuit::Spades, &mapping);
+
+    size_t best_idx = 0;
+    size_t best_score = 0;
+    bool has_best = false;
+    for (const cards_common::Card& card : hand) {
+        // card of suit with the same pattern as previous suit is symmetric to already evaluated one
+        const size_t slot = (size_t)card.suit_ - (size_t)cards_common::CardsSuit::Spades;
+        if (1 < slot &&
+            opening_book::suit_pattern(hand_mask, card.suit_) ==
+            opening_book::suit_pattern(hand_mask, (cards_common::CardsSuit)((size_t)card.suit_ - 1)))
+            continue;
+
+        attacker.set_first_attack(card);
+        size_t score = 0; // 2 - win, 1 - draw
+        for (const auto& deal : deals) {
+            game.init(std::make_shared<OpeningState>(hand, deal.first), deal.second);
+            switch (game.run()) {
+            case 1:
+                score += 2;
+                break;
+            case -1:
+                score += 1;
+                break;
+            }
+        }
+        if (!has_best || best_score < score) {
+            has_best = true;
+            best_score = score;
+            best_idx = opening_book::canonical_card_index(card, mapping);
+        }
+    }
+    return best_idx;
+}
+} // namespace
+
+int main(int argc, const char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <book_path> [games_per_card = 200] [threads = all cores] [seed = 1]" << std::endl;
+        return 1;
+    }
+    const std::string book_path = argv[1];
+    const size_t games_per_card = (2 < argc) ? std::stoul(argv[2]) : 200;
+    size_t threads_cnt = (3 < argc) ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    const unsigned int seed = (4 < argc) ? (unsigned int)std::stoul(argv[4]) : 1;
+    if (0 == threads_cnt)
+        threads_cnt = 1;
+
+    const std::vector<uint64_t> keys = canonical_keys();
+    std::cout << "Canonical positions: " << keys.size() << std::endl;
+
+    std::vector<size_t> best_cards(keys.size());
+    std::atomic<size_t> next_key(0);
+    std::atomic<size_t> done_cnt(0);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads_cnt; t++) {
+        workers.emplace_back([&]() {
+            Game<2> game;
+            GameHandDecisionForcedFirstAttack* attacker = new GameHandDecisionForcedFirstAttack();
+            game.set_hand_decision(0, std::unique_ptr< GameHandDecision<2> >(attacker));
+            game.set_hand_decision(1, std::unique_ptr< GameHandDecision<2> >(new GameHandDecisionAttackDefendLessCard<2>()));
+            for (size_t idx = next_key++; idx < keys.size(); idx = next_key++) {
+                best_cards[idx] = evaluate_position(keys[idx], games_per_card, seed, game, *attacker);
+                const size_t done = ++done_cnt;
+                if (0 == done % 10000)
+                    std::cout << "\r" << done << " / " << keys.size() << std::flush;
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    std::cout << "\r" << keys.size() << " / " << keys.size() << std::endl;
+
+    opening_book::OpeningBookWriter writer;
+    for (size_t idx = 0; idx < keys.size(); idx++)
+        writer.add(keys[idx], best_cards[idx]);
+    if (!writer.write(book_path, 2)) {
+        std::cerr << "Unable to write opening book: " << book_path << std::endl;
+        return 1;
+    }
+    std::cout << "Opening book saved: " << book_path << std::endl;
+    return 0;
+}
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+
+typedef std::default_random_engine              RandomGen;
+typedef std::uniform_real_distribution<double>  UniformReal;
+typedef std::uniform_int_distribution<int>      UniformInt;
+typedef std::normal_distribution<double>        NormalReal;
+
+template <class T, class _Pr>
+static size_t argmax(const std::vector<T> &vec, _Pr comp)
+{
+    if (0 == vec.size())
+        return -1;
+    size_t idx_max = 0;
+    for (size_t i = 1; i < vec.size(); i++)
+    {
+        if (comp(vec[idx_max], vec[i]))
+            idx_max = i;
+    }
+    return idx_max;
+}
+
+class MultiArmsBanditModel
+{
+public:
+    MultiArmsBanditModel(const std::vector<NormalReal::param_type> &param_rewards, unsigned seed = 1)
+        : m_generator(seed)
+        , m_arms_cnt(param_rewards.size())
+    {
+        for (size_t i = 0; i < m_arms_cnt; i++)
+        {
+            m_rng.push_back(NormalReal(param_rewards[i]));
+        }
+    }
+
+    virtual double get_reward(size_t arms_idx, size_t step)
+    {
+        return m_rng[arms_idx](m_generator);
+    }
+protected:
+    size_t m_arms_cnt;
+private:
+    RandomGen m_generator;
+    std::vector<NormalReal> m_rng;
+};
+
+class MultiArmsBanditModelPrecalc final
+    : public MultiArmsBanditModel
+{
+public:
+    MultiArmsBanditModelPrecalc(const std::vector<NormalReal::param_type> &param_rewards, size_t steps_cnt, unsigned seed = 1)
+        : MultiArmsBanditModel(param_rewards, seed)
+        , m_steps_cnt(steps_cnt)
+    {
+    }
+
+    double get_reward(size_t arms_idx, size_t step) override
+    {
+        if (m_rewards.empty())
+            precalcRewards();
+        return m_rewards.at<double>((int)step, (int)arms_idx);
+    }
+private:
+    size_t m_steps_cnt;
+    cv::Mat m_rewards;
+    void precalcRewards()
+    {
+        m_rewards.create((int)m_steps_cnt, (int)m_arms_cnt, CV_64FC1);
+        for (size_t step = 0; step < m_steps_cnt; step++)
+        {
+            double *ptr = m_rewards.ptr<double>((int)step);
+            for (size_t arm = 0; arm < m_arms_cnt; arm++)
+                ptr[arm] = MultiArmsBanditModel::get_reward(arm, step);
+        }
+    }
+};
+
+/*
+    Strategy concept, shared by MultiArmsBanditEpsGreedyStrategy and
+    MultiArmsBanditUCBStrategy:
+        Strategy(size_t arms_cnt, double param, int seed)
+        void start(double initValue), void start(const std::vector<double> &initValue)
+        size_t getNextStepArm()
+        void updateReward(size_t arm, double reward)
+    static const char *name() is the name of the strategy in experiment specs.
+*/
+class MultiArmsBanditEpsGreedyStrategy
+{
+    typedef std::pair<size_t, double>    AvgRevardsItem;
+    typedef std::vector<AvgRevardsItem>  AvgRevards;
+public:
+    MultiArmsBanditEpsGreedyStrategy(size_t arms_cnt, double epsilon = 0., int seed = 1)
+        : m_arms_cnt(arms_cnt)
+        , m_epsilon(epsilon)
+        , m_total_reward(0.)
+        , m_generator(seed)
+        , m_rng_select(0.0, 1.0)
+        , m_rng_arm(0, (int)arms_cnt - 1)
+    {
+        start();
+    }
+
+    static const char *name()
+    {
+        return "eps_greedy";
+    }
+
+    void start(double initValue = 0.)
+    {
+        m_avg_rewards.clear();
+        m_avg_rewards.resize(m_arms_cnt, std::pair<size_t, double>(0, initValue));
+        m_total_reward = 0.;
+    }
+    void start(const std::vector<double> &initValue)
+    {
+        m_avg_rewards.clear();
+        assert(m_arms_cnt == initValue.size());
+        for (size_t i = 0; i < m_arms_cnt; i++)
+        {
+            m_avg_rewards.push_back(std::pair<size_t, double>(0, initValue[i]));
+        }
+        m_total_reward = 0.;
+    }
+
+    size_t getNextStepArm()
+    {
+        size_t arm = 0;
+        if ((DBL_EPSILON > m_epsilon) || (m_rng_select(m_generator) > m_epsilon))
+        {
+            arm = argmax(m_avg_rewards, [](const AvgRevardsItem &item1, const AvgRevardsItem &item2)
+                                          { return item1.second < item2.second; });
+        }
+        else
+        {
+            arm = m_rng_arm(m_generator);
+        }
+        return arm;
+    }
+    void updateReward(size_t arm, double reward)
+    {
+        m_total_reward += reward;
+        m_avg_rewards[arm].first++;
+        m_avg_rewards[arm].second += (reward - m_avg_rewards[arm].second) / (double)m_avg_rewards[arm].first;
+    }
+private:
+    size_t m_arms_cnt;
+    double m_epsilon;
+    double m_total_reward;
+
+    RandomGen m_generator;
+    UniformReal m_rng_select;
+    UniformInt m_rng_arm;
+
+    AvgRevards m_avg_rewards;
+};
+
+/*
+    UCB: the arm with max avg + coeff * sqrt(log(t) / n), unvisited arms first.
+
+    Buffers are allocated by start() only, log(t) is computed once per step.
+    Small arms counts are scanned linearly. From tree_min_arms arms the bound
+    of an arm is the line avg + L / sqrt(n) of L = coeff * sqrt(log(t)), which
+    only grows, so the arms are kept in a kinetic tournament tree: every node
+    keeps the winner of its children and the L at which the loser overtakes
+    it. A step refreshes only the nodes whose L has passed and an update
+    refreshes the path of the arm, about O(log K) per step. The lines only
+    schedule the refreshes: nodes compare the bounds as the linear scan
+    computes them and a node whose pair of lines is within rounding is
+    replayed every step, so both paths pick the same arm, ties included.
+    Rewards of few values (0/1) give such pairs often, the tree gains less.
+*/
+class MultiArmsBanditUCBStrategy
+{
+    typedef std::pair<size_t, double>    AvgRevardsItem;
+    typedef std::vector<AvgRevardsItem>  AvgRevards;
+public:
+    static const size_t tree_min_arms = 64;
+
+    MultiArmsBanditUCBStrategy(size_t arms_cnt, double coeff = 0., int seed = 1)
+        : m_arms_cnt(arms_cnt)
+        , m_coeff(coeff)
+        , m_total_reward(std::make_pair(0, 0.))
+        , m_use_tree(tree_min_arms <= arms_cnt && 0. <= coeff)
+        , m_leaves_cnt(1)
+        , m_first_unvisited(0)
+        , m_log_total(0.)
+        , m_bound_scale(0.)
+    {
+        while (m_leaves_cnt < m_arms_cnt)
+            m_leaves_cnt *= 2;
+        start();
+    }
+
+    static const char *name()
+    {
+        return "ucb";
+    }
+
+    void start(double initValue = 0.)
+    {
+        m_avg_rewards.clear();
+        m_avg_rewards.resize(m_arms_cnt, std::pair<size_t, double>(0, initValue));
+        m_total_reward = std::make_pair(0, 0.);
+        startTree();
+    }
+    void start(const std::vector<double> &initValue)
+    {
+        m_avg_rewards.clear();
+        assert(m_arms_cnt == initValue.size());
+        for (size_t i = 0; i < m_arms_cnt; i++)
+        {
+            m_avg_rewards.push_back(std::pair<size_t, double>(0, initValue[i]));
+        }
+        m_total_reward = std::make_pair(0, 0.);
+        startTree();
+    }
+
+    size_t getNextStepArm()
+    {
+        while (m_first_unvisited < m_arms_cnt && 0 != m_avg_rewards[m_first_unvisited].first)
+            m_first_unvisited++;
+        if (m_first_unvisited < m_arms_cnt)
+            return m_first_unvisited;
+
+        const double log_total = log((double)m_total_reward.first);
+        if (m_use_tree)
+        {
+            advanceTree(log_total);
+            return (size_t)m_winner[1];
+        }
+
+        size_t arm_max = 0;
+        double ucb_max = -DBL_MAX;
+        for (size_t i = 0; i < m_arms_cnt; i++)
+        {
+            const double ucb = m_avg_rewards[i].second + m_coeff * sqrt(log_total / m_avg_rewards[i].first);
+            if (0 == i || ucb_max < ucb)
+            {
+                arm_max = i;
+                ucb_max = ucb;
+            }
+        }
+        return arm_max;
+    }
+    void updateReward(size_t arm, double reward)
+    {
+        m_total_reward.first++;
+        m_total_reward.second += reward;
+        m_avg_rewards[arm].first++;
+        m_avg_rewards[arm].second += (reward - m_avg_rewards[arm].second) / (double)m_avg_rewards[arm].first;
+        if (m_use_tree)
+            updateTree(arm);
+    }
+private:
+    size_t m_arms_cnt;
+    double m_coeff;
+    AvgRevardsItem m_total_reward;
+    AvgRevards m_avg_rewards;
+
+    // kinetic tournament tree, nodes 1..m_leaves_cnt-1, leaf of arm i is m_leaves_cnt + i
+    bool m_use_tree;
+    size_t m_leaves_cnt;
+    size_t m_first_unvisited;
+    double m_log_total;                 // log(t) of the winners in the tree
+    double m_bound_scale;               // L of the winners in the tree
+    std::vector<double> m_inv_sqrt_cnt; // slope of the bound line of an arm
+    std::vector<int> m_winner;          // -1 - no visited arm in the subtree
+    std::vector<double> m_fail_scale;   // a winner in the subtree may change for L above it
+
+    void startTree()
+    {
+        m_first_unvisited = 0;
+        if (!m_use_tree)
+            return;
+        m_log_total = 0.;
+        m_bound_scale = 0.;
+        m_inv_sqrt_cnt.assign(m_arms_cnt, 0.);
+        m_winner.assign(2 * m_leaves_cnt, -1);
+        m_fail_scale.assign(2 * m_leaves_cnt, DBL_MAX);
+    }
+    // the same expression as the linear scan, so the rounding is the same
+    double bound(int arm) const
+    {
+        return m_avg_rewards[arm].second + m_coeff * sqrt(m_log_total / m_avg_rewards[arm].first);
+    }
+    void updateTree(size_t arm)
+    {
+        m_inv_sqrt_cnt[arm] = 1. / sqrt((double)m_avg_rewards[arm].first);
+        size_t node = m_leaves_cnt + arm;
+        m_winner[node] = (int)arm;
+        for (node /= 2; 0 < node; node /= 2)
+            playNode(node);
+    }
+    void advanceTree(double log_total)
+    {
+        m_log_total = log_total;
+        m_bound_scale = m_coeff * sqrt(log_total);
+        if (m_fail_scale[1] < m_bound_scale)
+            refreshNode(1);
+    }
+    void refreshNode(size_t node)
+    {
+        if (m_leaves_cnt <= node)
+            return;
+        if (m_fail_scale[2 * node] < m_bound_scale)
+            refreshNode(2 * node);
+        if (m_fail_scale[2 * node + 1] < m_bound_scale)
+            refreshNode(2 * node + 1);
+        playNode(node);
+    }
+    // winner of the children at the current L; on a tie the lower arm, it is in the left child
+    void playNode(size_t node)
+    {
+        const int left = m_winner[2 * node];
+        const int right = m_winner[2 * node + 1];
+        double fail_scale = std::min(m_fail_scale[2 * node], m_fail_scale[2 * node + 1]);
+        if (-1 == left || -1 == right)
+        {
+            m_winner[node] = (-1 == left) ? right : left;
+        }
+        else
+        {
+            const bool right_wins = bound(left) < bound(right);
+            const int winner = right_wins ? right : left;
+            const int loser = right_wins ? left : right;
+            m_winner[node] = winner;
+            // the lines are apart by avg_diff - L * inv_diff, the order of the bounds is certain
+            // only while they are more than rounding apart, closer the node is replayed every step;
+            // of equal counts the bonus is the same and the left arm with not less avg always wins
+            const double avg_diff = m_avg_rewards[winner].second - m_avg_rewards[loser].second;
+            const double inv_diff = m_inv_sqrt_cnt[loser] - m_inv_sqrt_cnt[winner];
+            if (0. != inv_diff || m_avg_rewards[left].second < m_avg_rewards[right].second)
+            {
+                const double cross_scale = (0. < inv_diff) ? avg_diff / inv_diff : 0.;
+                const double rounding = 1e-12 * (1. + fabs(m_avg_rewards[winner].second) + fabs(m_avg_rewards[loser].second)
+                                                 + std::max(cross_scale, m_bound_scale) * (m_inv_sqrt_cnt[winner] + m_inv_sqrt_cnt[loser]));
+                if (0. < inv_diff)
+                    fail_scale = std::min(fail_scale, (avg_diff - rounding) / inv_diff);
+                else if (avg_diff - m_bound_scale * inv_diff <= rounding)
+                    fail_scale = -DBL_MAX;
+            }
+        }
+        m_fail_scale[node] = fail_scale;
+    }
+};
+
+// steps of one run, the reward of step i is added to step_rewards(i, col); Model and Strategy calls are inlined
+template <class Model, class Strategy>
+inline void runBanditStrategy(Model &model, Strategy &strategy, size_t steps_cnt, cv::Mat &step_rewards, int col)
+{
+    for (size_t i = 0; i < steps_cnt; i++)
+    {
+        const size_t arm = strategy.getNextStepArm();
+
+        const double reward = model.get_reward(arm, i);
+        strategy.updateReward(arm, reward);
+
+        step_rewards.at<double>((int)i, col) += reward;
+    }
+}
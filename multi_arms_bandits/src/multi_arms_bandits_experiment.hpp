@@ -0,0 +1,148 @@
+#pragma once
+
+#include "multi_arms_bandits.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+/*
+    Experiment spec: settings and strategy lines, '#' starts a comment.
+
+        arms 10
+        steps 1000
+        runs 2000
+        <strategy> <param>[,<param>...] [<init>[,<init>...]]
+
+    A strategy line adds a column for every param x init pair, params in the
+    outer loop. init is a number or "means" - true means of the arms, default 0.
+    Columns keep the order of the spec; the strategy of column a gets seed
+    a + run + 1.
+*/
+struct MultiArmsBanditColumnSpec
+{
+    std::string strategy;
+    double param = 0.;
+    bool init_means = false;
+    double init_value = 0.;
+};
+
+struct MultiArmsBanditExperimentSpec
+{
+    size_t arms_cnt = 10;
+    size_t run_steps_cnt = 1000;
+    int runs_cnt = 2000;
+    std::vector<MultiArmsBanditColumnSpec> columns;
+
+    static MultiArmsBanditExperimentSpec parse(std::istream &stream, const std::string &source = "spec")
+    {
+        MultiArmsBanditExperimentSpec spec;
+        std::string line;
+        for (size_t line_idx = 1; std::getline(stream, line); line_idx++)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream line_stream(line);
+            std::string key;
+            if (!(line_stream >> key))
+                continue;
+            const std::string where = source + ":" + std::to_string(line_idx) + ": ";
+
+            std::string params, inits;
+            if (!(line_stream >> params))
+                throw std::runtime_error(where + "missing value of " + key);
+            line_stream >> inits;
+            if ("arms" == key)
+                spec.arms_cnt = std::stoul(params);
+            else if ("steps" == key)
+                spec.run_steps_cnt = std::stoul(params);
+            else if ("runs" == key)
+                spec.runs_cnt = std::stoi(params);
+            else if (MultiArmsBanditEpsGreedyStrategy::name() == key || MultiArmsBanditUCBStrategy::name() == key)
+            {
+                for (const auto &param : split(params))
+                {
+                    for (const auto &init : split(inits.empty() ? "0" : inits))
+                    {
+                        MultiArmsBanditColumnSpec column;
+                        column.strategy = key;
+                        column.param = std::stod(param);
+                        column.init_means = ("means" == init);
+                        column.init_value = column.init_means ? 0. : std::stod(init);
+                        spec.columns.push_back(column);
+                    }
+                }
+            }
+            else
+                throw std::runtime_error(where + "unknown strategy " + key);
+        }
+        if (0 == spec.arms_cnt || 0 == spec.run_steps_cnt || 0 >= spec.runs_cnt || spec.columns.empty())
+            throw std::runtime_error(source + ": empty experiment");
+        return spec;
+    }
+    static MultiArmsBanditExperimentSpec load(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file)
+            throw std::runtime_error("Unable to read experiment: " + path);
+        return parse(file, path);
+    }
+    // epsilon-greedy with different epsilons and initial values against UCB
+    static MultiArmsBanditExperimentSpec defaultSpec()
+    {
+        std::istringstream stream(
+            "arms 10\n"
+            "steps 1000\n"
+            "runs 2000\n"
+            "eps_greedy 0,2.0,0.5,0.25,0.1,0.05,0.025,0.01,0.005,0.0025,0.001\n"
+            "eps_greedy 0 10,-10,means\n"
+            "eps_greedy 0.05 10\n"
+            "ucb 0.5,1,1.5,2,8\n");
+        return parse(stream, "default spec");
+    }
+private:
+    static std::vector<std::string> split(const std::string &list)
+    {
+        std::vector<std::string> items;
+        std::istringstream stream(list);
+        for (std::string item; std::getline(stream, item, ',');)
+            items.push_back(item);
+        return items;
+    }
+};
+
+// one run of column on model, seed of the strategy is seed
+template <class Strategy, class Model>
+void runBanditColumn(const MultiArmsBanditColumnSpec &column, const std::vector<double> &means,
+                     Model &model, size_t steps_cnt, int seed, cv::Mat &step_rewards, int col)
+{
+    Strategy strategy(means.size(), column.param, seed);
+    if (column.init_means)
+        strategy.start(means);
+    else
+        strategy.start(column.init_value);
+    runBanditStrategy(model, strategy, steps_cnt, step_rewards, col);
+}
+
+// one run of all columns of the spec on one model, rewards go to step_rewards (steps x columns)
+template <class Model>
+void runBanditExperiment(const MultiArmsBanditExperimentSpec &spec, const std::vector<NormalReal::param_type> &param_rewards,
+                         Model &model, int run, cv::Mat &step_rewards)
+{
+    std::vector<double> means(param_rewards.size());
+    for (size_t i = 0; i < param_rewards.size(); i++)
+        means[i] = param_rewards[i].mean();
+
+    for (int a = 0; a < (int)spec.columns.size(); a++)
+    {
+        const MultiArmsBanditColumnSpec &column = spec.columns[a];
+        if (MultiArmsBanditUCBStrategy::name() == column.strategy)
+            runBanditColumn<MultiArmsBanditUCBStrategy>(column, means, model, spec.run_steps_cnt, a + run + 1, step_rewards, a);
+        else
+            runBanditColumn<MultiArmsBanditEpsGreedyStrategy>(column, means, model, spec.run_steps_cnt, a + run + 1, step_rewards, a);
+    }
+}
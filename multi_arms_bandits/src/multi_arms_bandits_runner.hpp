@@ -0,0 +1,95 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+
+/*
+    Runs of an experiment on worker threads.
+
+    Every run fills its own steps x columns rewards matrix. Runs go in windows
+    of a few runs per thread; the rewards of a window are added to the sum by
+    row ranges in parallel, each element in run order. So the sum is the same
+    bit for bit as the sequential loop over runs, whatever the threads count.
+*/
+class MultiArmsBanditRunner
+{
+public:
+    typedef std::function<void(int run, cv::Mat &run_rewards)>   RunFunc;
+    typedef std::function<void(int runs_done)>                   ProgressFunc;
+
+    // threads_cnt == 0 - all cores
+    MultiArmsBanditRunner(size_t threads_cnt = 0)
+        : m_threads_cnt(0 == threads_cnt ? std::max(1u, std::thread::hardware_concurrency()) : threads_cnt)
+    {
+    }
+
+    size_t threadsCnt() const
+    {
+        return m_threads_cnt;
+    }
+
+    // sum of run_rewards of runs [0, runs_cnt), run_func adds rewards to a zeroed matrix
+    cv::Mat run(int runs_cnt, int rows, int cols, const RunFunc &run_func, const ProgressFunc &progress = ProgressFunc())
+    {
+        cv::Mat sum_rewards = cv::Mat::zeros(rows, cols, CV_64FC1);
+        const int window_size = (int)(4 * m_threads_cnt);
+        std::vector<cv::Mat> run_rewards(std::min(window_size, runs_cnt));
+        for (auto &rewards : run_rewards)
+            rewards.create(rows, cols, CV_64FC1);
+
+        for (int window_begin = 0; window_begin < runs_cnt; window_begin += window_size)
+        {
+            const int window_end = std::min(runs_cnt, window_begin + window_size);
+            parallelFor(window_end - window_begin, [&](size_t i)
+            {
+                run_rewards[i] = cv::Scalar::all(0.);
+                run_func(window_begin + (int)i, run_rewards[i]);
+            });
+
+            const int rows_per_task = std::max(1, rows / (int)(4 * m_threads_cnt));
+            parallelFor((rows + rows_per_task - 1) / rows_per_task, [&](size_t task)
+            {
+                const int row_end = std::min(rows, (int)(task + 1) * rows_per_task);
+                for (int row = (int)task * rows_per_task; row < row_end; row++)
+                {
+                    double *sum_ptr = sum_rewards.ptr<double>(row);
+                    for (int run = 0; run < window_end - window_begin; run++)
+                    {
+                        const double *run_ptr = run_rewards[run].ptr<double>(row);
+                        for (int col = 0; col < cols; col++)
+                            sum_ptr[col] += run_ptr[col];
+                    }
+                }
+            });
+
+            if (progress)
+                progress(window_end);
+        }
+        return sum_rewards;
+    }
+private:
+    size_t m_threads_cnt;
+
+    // func(i) for i in [0, tasks_cnt) on m_threads_cnt threads, the caller is one of them
+    void parallelFor(size_t tasks_cnt, const std::function<void(size_t)> &func)
+    {
+        std::atomic<size_t> next_task(0);
+        auto worker = [&]()
+        {
+            for (size_t task = next_task++; task < tasks_cnt; task = next_task++)
+                func(task);
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(m_threads_cnt, tasks_cnt); i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto &thread : threads)
+            thread.join();
+    }
+};
@@ -0,0 +1,103 @@
+#include "multi_arms_bandits.hpp"
+
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+/*
+    The tournament tree of MultiArmsBanditUCBStrategy picks the same arms as
+    the linear scan, ties of 0/1 rewards included.
+*/
+
+// linear scan of MultiArmsBanditUCBStrategy for any arms count
+class LinearUCB
+{
+public:
+    LinearUCB(size_t arms_cnt, double coeff)
+        : m_coeff(coeff)
+        , m_total_cnt(0)
+        , m_avg_rewards(arms_cnt, std::pair<size_t, double>(0, 0.))
+    {
+    }
+
+    size_t getNextStepArm() const
+    {
+        for (size_t i = 0; i < m_avg_rewards.size(); i++)
+        {
+            if (0 == m_avg_rewards[i].first)
+                return i;
+        }
+        const double log_total = log((double)m_total_cnt);
+        size_t arm_max = 0;
+        double ucb_max = -DBL_MAX;
+        for (size_t i = 0; i < m_avg_rewards.size(); i++)
+        {
+            const double ucb = m_avg_rewards[i].second + m_coeff * sqrt(log_total / m_avg_rewards[i].first);
+            if (0 == i || ucb_max < ucb)
+            {
+                arm_max = i;
+                ucb_max = ucb;
+            }
+        }
+        return arm_max;
+    }
+    void updateReward(size_t arm, double reward)
+    {
+        m_total_cnt++;
+        m_avg_rewards[arm].first++;
+        m_avg_rewards[arm].second += (reward - m_avg_rewards[arm].second) / (double)m_avg_rewards[arm].first;
+    }
+private:
+    double m_coeff;
+    size_t m_total_cnt;
+    std::vector<std::pair<size_t, double>> m_avg_rewards;
+};
+
+// first step the tree and the linear scan pick different arms, steps_cnt if none
+size_t firstDifferentStep(size_t arms_cnt, double coeff, size_t steps_cnt, unsigned seed)
+{
+    RandomGen generator(seed);
+    std::vector<std::bernoulli_distribution> rewards;
+    for (size_t i = 0; i < arms_cnt; i++)
+        rewards.push_back(std::bernoulli_distribution(UniformReal(0.2, 0.8)(generator)));
+
+    MultiArmsBanditUCBStrategy tree(arms_cnt, coeff);
+    LinearUCB linear(arms_cnt, coeff);
+    for (size_t step = 0; step < steps_cnt; step++)
+    {
+        const size_t arm = tree.getNextStepArm();
+        if (arm != linear.getNextStepArm())
+            return step;
+        const double reward = rewards[arm](generator) ? 1. : 0.;
+        tree.updateReward(arm, reward);
+        linear.updateReward(arm, reward);
+    }
+    return steps_cnt;
+}
+
+int main()
+{
+    const size_t steps_cnt = 20000;
+    int failures_cnt = 0;
+    for (size_t arms_cnt : { MultiArmsBanditUCBStrategy::tree_min_arms, (size_t)200, (size_t)1000 })
+    {
+        for (double coeff : { 0.5, 1., 2. })
+        {
+            for (unsigned seed = 1; seed <= 3; seed++)
+            {
+                const size_t step = firstDifferentStep(arms_cnt, coeff, steps_cnt, seed);
+                if (steps_cnt == step)
+                    continue;
+                std::cerr << "FAILED: " << arms_cnt << " arms, coeff " << coeff << ", seed " << seed
+                          << ": the tree and the linear scan differ at step " << step << std::endl;
+                failures_cnt++;
+            }
+        }
+    }
+    if (0 != failures_cnt)
+        return 1;
+    std::cout << "OK" << std::endl;
+    return 0;
+}